@@ -0,0 +1,78 @@
+#pragma once
+
+#include "StringInterner.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Ids handed out in first-seen order for a set of interned names
+class SymbolDictionary {
+private:
+    std::vector<Symbol> symbols;                  // Id -> name
+    std::unordered_map<Symbol, uint32_t> ids;     // Name -> id
+
+public:
+    SymbolDictionary();
+
+    // Id for symbol, adding it on first use
+    uint32_t encode(Symbol symbol);
+
+    // Id for symbol, false if it was never added
+    bool find(Symbol symbol, uint32_t& id) const;
+
+    Symbol decode(uint32_t id) const;
+    size_t size() const;
+    void clear();
+};
+
+// Counts over a channel's events
+struct ColumnCounts {
+    size_t total;
+    size_t active;
+    size_t forcesArrival;
+    size_t activeWithForces; // Both active and forces arrival at scene
+};
+
+// Events of one channel stored a column at a time, for analytics over millions of events.
+// Times are a plain int32 array, the two general information flags are bitsets and
+// names are dictionary coded, so counts, group-by and histograms are tight scans and
+// popcounts over contiguous memory instead of walks over event records.
+// Rows are kept in arrival order. Not thread-safe, the owner locks around it.
+class ColumnStore {
+private:
+    std::vector<int32_t> dateTimes;
+    std::vector<uint32_t> cityIds;
+    std::vector<uint32_t> nameIds;
+    std::vector<uint32_t> userIds;
+    std::vector<uint64_t> activeBits;        // Bit i of word i / 64 is row i
+    std::vector<uint64_t> forcesArrivalBits;
+    SymbolDictionary cities;
+    SymbolDictionary names;
+    SymbolDictionary users;
+
+    static void setBit(std::vector<uint64_t>& bits, size_t row, bool value);
+
+public:
+    ColumnStore();
+
+    // Append a row, generalFlags holds GeneralInformationFlag bits
+    void append(Symbol user, Symbol city, Symbol name, int dateTime, unsigned char generalFlags);
+
+    // Drop every row reported by user, keeping the others in order
+    void removeUser(Symbol user);
+
+    size_t size() const;
+    void clear();
+
+    // Totals by popcount over the flag bitsets
+    ColumnCounts counts() const;
+
+    // Number of rows per city, in first-seen city order, cities without rows left out
+    std::vector<std::pair<Symbol, size_t>> countByCity() const;
+
+    // Rows per time bucket: bucket i counts from + i * bucketSeconds <= date time < from + (i + 1) * bucketSeconds.
+    // Rows outside the buckets are not counted.
+    std::vector<size_t> histogram(int from, int bucketSeconds, size_t buckets) const;
+};
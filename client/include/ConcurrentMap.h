@@ -0,0 +1,342 @@
+#pragma once
+
+#include "FrameView.h"
+#include "SharedMutex.h"
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Hashes std::string keys and StringSlice lookups alike, so a map keyed by std::string
+// can be searched with a slice of a received frame without building a temporary string.
+struct StringKeyHash {
+    size_t operator()(const char* data, size_t size) const {
+        // FNV-1a, the map mixes the result further
+        size_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+    size_t operator()(const std::string& key) const { return (*this)(key.data(), key.size()); }
+    size_t operator()(const StringSlice& key) const { return (*this)(key.data, key.size); }
+    size_t operator()(const char* key) const { return (*this)(key, std::strlen(key)); }
+};
+
+struct StringKeyEqual {
+    bool operator()(const std::string& key, const std::string& other) const { return key == other; }
+    bool operator()(const std::string& key, const StringSlice& other) const {
+        return key.size() == other.size && std::memcmp(key.data(), other.data, other.size) == 0;
+    }
+    bool operator()(const std::string& key, const char* other) const { return key == other; }
+};
+
+// Thread-safe hash map split into independently locked shards.
+// Each shard is an open-addressing table with linear probing, so a lookup is a hash,
+// one lock on the key's shard and a short scan of adjacent slots. Operations on keys in
+// different shards never contend. Shard tables are allocated on first insert.
+//
+// Lookups are templated on the key type, so any type Hash and KeyEqual accept can be
+// used to search (e.g. StringSlice with StringKeyHash/StringKeyEqual).
+// With Mutex = SharedMutex lookups take the shard lock shared, for read-mostly maps.
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+          typename Mutex = std::mutex, size_t Shards = 16>
+class ConcurrentMap {
+private:
+    enum SlotState : unsigned char { EMPTY, FULL, DELETED };
+
+    struct Slot {
+        SlotState state;
+        K key;
+        V value;
+
+        Slot() : state(EMPTY), key(), value() {}
+    };
+
+    struct Shard {
+        mutable Mutex lock;
+        std::vector<Slot> slots; // Power-of-two sized, empty until first insert
+        size_t count;            // FULL slots
+        size_t used;             // FULL and DELETED slots, drives rehashing
+
+        Shard() : lock(), slots(), count(0), used(0) {}
+    };
+
+    typedef std::lock_guard<Mutex> WriteLock;
+    typedef ReadLockGuard<Mutex> ReadLock;
+
+    static const size_t INITIAL_CAPACITY = 8;
+
+    Hash hasher;
+    KeyEqual equal;
+    Shard shards[Shards];
+
+    // Spread the hash so keys with an identity hash (ints) still use every bit
+    static size_t mix(size_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    template <typename Q>
+    size_t hashOf(const Q& key) const {
+        return mix(hasher(key));
+    }
+
+    Shard& shardFor(size_t hash) {
+        return shards[(hash >> (sizeof(size_t) * 8 - 16)) % Shards];
+    }
+
+    const Shard& shardFor(size_t hash) const {
+        return shards[(hash >> (sizeof(size_t) * 8 - 16)) % Shards];
+    }
+
+    // Index of the slot holding key, or -1. Caller holds the shard lock.
+    template <typename Q>
+    long find(const Shard& shard, size_t hash, const Q& key) const {
+        if (shard.slots.empty()) {
+            return -1;
+        }
+        size_t mask = shard.slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = shard.slots[i];
+            if (slot.state == EMPTY) {
+                return -1;
+            }
+            if (slot.state == FULL && equal(slot.key, key)) {
+                return static_cast<long>(i);
+            }
+        }
+    }
+
+    // Rebuild the shard's table, dropping tombstones. Caller holds the shard lock.
+    void rehash(Shard& shard, size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(shard.slots);
+        shard.slots.resize(capacity);
+        shard.count = 0;
+        shard.used = 0;
+        for (Slot& slot : old) {
+            if (slot.state == FULL) {
+                place(shard, hashOf(slot.key), std::move(slot.key), std::move(slot.value));
+            }
+        }
+    }
+
+    // Make room for one more key. Caller holds the shard lock.
+    void reserveOne(Shard& shard) {
+        // Keep at most half the slots in use so probe sequences stay short
+        if (shard.slots.empty()) {
+            shard.slots.resize(INITIAL_CAPACITY);
+        } else if ((shard.used + 1) * 2 > shard.slots.size()) {
+            size_t capacity = shard.slots.size();
+            while ((shard.count + 1) * 2 > capacity) {
+                capacity *= 2;
+            }
+            rehash(shard, capacity);
+        }
+    }
+
+    // Put a key known to be absent into the table, returning its slot. Caller holds the shard lock.
+    static Slot& place(Shard& shard, size_t hash, K&& key, V&& value) {
+        size_t mask = shard.slots.size() - 1;
+        size_t i = hash & mask;
+        while (shard.slots[i].state == FULL) {
+            i = (i + 1) & mask;
+        }
+        Slot& slot = shard.slots[i];
+        if (slot.state == EMPTY) {
+            ++shard.used;
+        }
+        slot.state = FULL;
+        slot.key = std::move(key);
+        slot.value = std::move(value);
+        ++shard.count;
+        return slot;
+    }
+
+    // Empty a slot, leaving a tombstone so probe chains stay intact. Caller holds the shard lock.
+    static void erase(Shard& shard, size_t index) {
+        Slot& slot = shard.slots[index];
+        slot.state = DELETED;
+        slot.key = K();
+        slot.value = V();
+        --shard.count;
+    }
+
+public:
+    ConcurrentMap() : hasher(), equal(), shards() {}
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    // Inserts or updates a key-value pair
+    void insertOrUpdate(const K& key, const V& value) {
+        size_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        WriteLock lock(shard.lock);
+        long index = find(shard, hash, key);
+        if (index >= 0) {
+            shard.slots[index].value = value;
+            return;
+        }
+        reserveOne(shard);
+        place(shard, hash, K(key), V(value));
+    }
+
+    // Inserts a value built from args unless the key is present, the args are unused then
+    // Returns true if the value was inserted
+    template <typename... Args>
+    bool tryEmplace(const K& key, Args&&... args) {
+        size_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        WriteLock lock(shard.lock);
+        if (find(shard, hash, key) >= 0) {
+            return false;
+        }
+        reserveOne(shard);
+        place(shard, hash, K(key), V(std::forward<Args>(args)...));
+        return true;
+    }
+
+    // Runs update(value) under the shard lock, inserting a default value first if the key is absent
+    // Returns what update returns
+    template <typename F>
+    auto compute(const K& key, F update) -> decltype(update(std::declval<V&>())) {
+        size_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        WriteLock lock(shard.lock);
+        long index = find(shard, hash, key);
+        if (index >= 0) {
+            return update(shard.slots[index].value);
+        }
+        reserveOne(shard);
+        return update(place(shard, hash, K(key), V()).value);
+    }
+
+    // Runs update(value) under the shard lock if the key is present
+    // Returns false if the key was not present
+    template <typename Q, typename F>
+    bool updateIf(const Q& key, F update) {
+        size_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        WriteLock lock(shard.lock);
+        long index = find(shard, hash, key);
+        if (index < 0) {
+            return false;
+        }
+        update(shard.slots[index].value);
+        return true;
+    }
+
+    // Retrieves the value associated with a key
+    // Returns true if the key exists, false otherwise
+    template <typename Q>
+    bool get(const Q& key, V& value) const {
+        size_t hash = hashOf(key);
+        const Shard& shard = shardFor(hash);
+        ReadLock lock(shard.lock);
+        long index = find(shard, hash, key);
+        if (index < 0) {
+            return false;
+        }
+        value = shard.slots[index].value;
+        return true;
+    }
+
+    // Runs reader(value) under the shard lock if the key is present, without copying the value out
+    // Returns false if the key was not present
+    template <typename Q, typename F>
+    bool visit(const Q& key, F reader) const {
+        size_t hash = hashOf(key);
+        const Shard& shard = shardFor(hash);
+        ReadLock lock(shard.lock);
+        long index = find(shard, hash, key);
+        if (index < 0) {
+            return false;
+        }
+        reader(static_cast<const V&>(shard.slots[index].value));
+        return true;
+    }
+
+    // Retrieves the value for a given key directly (throws if not found)
+    V getValue(const K& key) const {
+        V value;
+        if (!get(key, value)) {
+            std::ostringstream message;
+            message << "Key not found: " << key;
+            throw std::runtime_error(message.str());
+        }
+        return value;
+    }
+
+    // Removes a key and hands back its value under a single lock
+    // Returns false if the key was not present
+    template <typename Q>
+    bool takeIfPresent(const Q& key, V& value) {
+        size_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        WriteLock lock(shard.lock);
+        long index = find(shard, hash, key);
+        if (index < 0) {
+            return false;
+        }
+        value = std::move(shard.slots[index].value);
+        erase(shard, index);
+        return true;
+    }
+
+    // Removes a key
+    template <typename Q>
+    bool remove(const Q& key) {
+        size_t hash = hashOf(key);
+        Shard& shard = shardFor(hash);
+        WriteLock lock(shard.lock);
+        long index = find(shard, hash, key);
+        if (index < 0) {
+            return false;
+        }
+        erase(shard, index);
+        return true;
+    }
+
+    // Checks if a key exists
+    template <typename Q>
+    bool contains(const Q& key) const {
+        size_t hash = hashOf(key);
+        const Shard& shard = shardFor(hash);
+        ReadLock lock(shard.lock);
+        return find(shard, hash, key) >= 0;
+    }
+
+    // Returns the size of the map, each shard is counted under its own lock
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) {
+            ReadLock lock(shard.lock);
+            total += shard.count;
+        }
+        return total;
+    }
+
+    // Clears all elements from the map and releases the tables
+    void clear() {
+        for (Shard& shard : shards) {
+            WriteLock lock(shard.lock);
+            std::vector<Slot>().swap(shard.slots);
+            shard.count = 0;
+            shard.used = 0;
+        }
+    }
+};
+
+// std::string-keyed map that can also be searched with a StringSlice
+template <typename V, typename Mutex = std::mutex>
+using StringConcurrentMap = ConcurrentMap<std::string, V, StringKeyHash, StringKeyEqual, Mutex>;
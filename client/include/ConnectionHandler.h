@@ -1,21 +1,113 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <iostream>
 #include <boost/asio.hpp>
+#include "FrameView.h"
+#include "StructuralIndex.h"
 
 using boost::asio::ip::tcp;
 
+// Connection to the STOMP server.
+// The blocking calls (getFrameAscii, sendFrameAscii, ...) serve a caller that owns the connection.
+// The async calls (startReading, asyncSendFrames, asyncClose) run as completion handlers on an
+// io_service, serialized by a per-connection strand, so one io_service can drive many
+// connections. Async calls need a handler made by create(), and the two styles must not be
+// mixed on one connection.
 class ConnectionHandler {
+public:
+	// Called with each frame read by startReading, the view is valid only during the call
+	typedef std::function<void(const FrameView &)> FrameHandler;
+	// Called once when the connection stops reading, with the error that stopped it
+	typedef std::function<void(const boost::system::error_code &)> CloseHandler;
+	// Called once the frames of an asyncSendFrames call are written, false if the write failed
+	typedef std::function<void(bool)> SendHandler;
+
 private:
+	// Frames queued by asyncSendFrames, kept alive until their write completes
+	struct PendingSend {
+		std::vector<std::string> frames;
+		boost::asio::const_buffer bytes;   // Borrowed, already delimited frames from asyncSendBytes
+		SendHandler onSent;
+
+		PendingSend() : frames(), bytes(), onSent() {}
+	};
+
 	const std::string host_;
 	const short port_;
-	boost::asio::io_service io_service_;   // Provides core I/O functionality
+	std::unique_ptr<boost::asio::io_service> ownedIoService_; // Set unless an io_service was given
+	boost::asio::io_service &io_service_;  // Provides core I/O functionality
+	boost::asio::io_service::strand strand_; // Serializes this connection's completion handlers
 	tcp::socket socket_;
+	std::vector<char> recvBuffer_;         // Bytes read from the socket but not yet consumed
+	size_t recvStart_;                     // First unconsumed byte in recvBuffer_
+	size_t recvEnd_;                       // One past the last valid byte in recvBuffer_
+	size_t sendBatchSize_;                 // Frames gathered into one vectored write by writeQueued
+
+	// Async reading state, touched only on the strand
+	char readDelimiter_;
+	StructuralIndex readIndex_;            // Marks of the unconsumed received bytes, as offsets into recvBuffer_
+	FrameHandler onFrame_;
+	CloseHandler onClosed_;
+	bool closeRequested_;                  // Set by asyncClose, reading then ends with operation_aborted
+
+	// Async sending state, touched only on the strand
+	std::deque<PendingSend> sendQueue_;
+	size_t sendsInFlight_;                 // Entries at the front of sendQueue_ being written
+	std::vector<boost::asio::const_buffer> writeBuffers_;
+
+	std::weak_ptr<ConnectionHandler> self_; // Set by create(), pending async operations hold a strong reference
+
+	// Strong reference for a completion handler, throws std::bad_weak_ptr unless made by create()
+	std::shared_ptr<ConnectionHandler> lockSelf() const;
+
+	// Make room at the end of the receive buffer for the next read
+	void prepareBuffer();
+
+	// Refill the receive buffer with a single read from the socket - blocking.
+	// Returns false in case the connection is closed or an error occurred.
+	bool fillBuffer();
+
+	// Issue the next async read into the receive buffer
+	void readSome();
+
+	// Dispatch every complete frame a read delivered, then read again
+	void handleRead(const boost::system::error_code &error, size_t bytesRead);
+
+	// Write the queued frames, gathering up to the batch size of them into one write
+	void writeQueued();
+
+	void handleWrite(const boost::system::error_code &error);
+
+	// Move the next complete frame out of the receive buffer, without touching the socket.
+	// Returns false in case no delimiter is buffered yet.
+	bool takeBufferedFrame(std::string &frame, char delimiter);
 
 public:
+	// Size the receive buffer starts at, enough for the frames of an idle session.
+	static const size_t INITIAL_RECV_BUFFER_SIZE = 1 << 12;
+
+	// Size the receive buffer grows to under load, a single read may deliver this many bytes.
+	static const size_t RECV_BUFFER_SIZE = 1 << 16;
+
+	// Default number of frames per vectored write.
+	static const size_t DEFAULT_SEND_BATCH_SIZE = 64;
+
 	ConnectionHandler(std::string host, short port);
 
+	// Run on an io_service shared with other connections
+	ConnectionHandler(boost::asio::io_service &ioService, std::string host, short port);
+
+	// Make a handler that can be used asynchronously on a shared io_service
+	static std::shared_ptr<ConnectionHandler> create(boost::asio::io_service &ioService, std::string host, short port);
+
+	ConnectionHandler(const ConnectionHandler &) = delete;
+	ConnectionHandler &operator=(const ConnectionHandler &) = delete;
+
 	virtual ~ConnectionHandler();
 
 	// Connect to the remote machine
@@ -45,7 +137,29 @@ public:
 	// Returns false in case connection is closed before all the data is sent.
 	bool sendFrameAscii(const std::string &frame, char delimiter);
 
+	// Set how many queued frames are gathered into one write, at least 1.
+	void setSendBatchSize(size_t frames);
+
+	size_t getSendBatchSize() const;
+
 	// Close down the connection properly.
 	void close();
 
+	// Read frames asynchronously, handing each to onFrame until the connection closes.
+	// Both handlers run on the io_service's threads, one at a time for this connection.
+	void startReading(char delimiter, FrameHandler onFrame, CloseHandler onClosed);
+
+	// Queue frames, each followed by a null character, for writing in order.
+	// May be called from any thread, onSent (if given) runs on the io_service.
+	void asyncSendFrames(std::vector<std::string> frames, SendHandler onSent = SendHandler());
+
+	void asyncSendFrame(std::string frame, SendHandler onSent = SendHandler());
+
+	// Queue bytes that already hold whole frames with their delimiters, e.g. a FrameWriter's.
+	// The bytes are not copied and must stay untouched until onSent runs.
+	void asyncSendBytes(const char *bytes, size_t size, SendHandler onSent);
+
+	// Close the connection from any thread, pending reads end with operation_aborted.
+	void asyncClose();
+
 }; //class ConnectionHandler
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "FrameView.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One journaled event, or a user's removal when clearsUser is set, in which case only user
+// is filled in. During replay the slices point into the mapped journal.
+struct JournalRecord {
+    StringSlice channel;
+    StringSlice user;
+    StringSlice city;
+    StringSlice name;
+    StringSlice description;
+    int dateTime;
+    unsigned char generalFlags; // GeneralInformationFlag bits
+    bool clearsUser;            // Drop every event user journaled before this record
+
+    JournalRecord();
+};
+
+// Append-only file of the events the client stored, replayed on the next start.
+// After an 8 byte magic and the offset of the first record, each record is its payload length,
+// a checksum of the payload and the payload: date time, flags, the five string lengths and then
+// the strings, in host byte order. A user's removal is a record with only the user and the top
+// flag bit set, so replay drops what a logged out user reported just as the running client did.
+// Offsets count from the start of the journal as first written. Once a snapshot covers the
+// records before some offset, rollOver() moves the rest to a fresh file that starts at that
+// offset, so the journal stays about as long as what came after the last snapshot.
+// A crash can only tear the last records, so replay stops at the first record that is short
+// or fails its checksum and cuts the file back to the records before it.
+// Appends only copy into a pending buffer. A committer thread writes everything pending
+// with one write (group commit) once GROUP_COMMIT_BYTES have gathered or COMMIT_INTERVAL_MS
+// have passed, and syncs after each write if the policy asks for it. An append that would take
+// the pending buffer past MAX_PENDING_BYTES waits for the committer's write instead, so a disk
+// slower than the events holds the appenders back rather than growing memory. Thread-safe.
+class EventJournal {
+public:
+    enum SyncPolicy {
+        NO_SYNC,         // Leave flushing to the page cache, survives a client crash but not a power loss
+        SYNC_EACH_COMMIT // fdatasync after every group write
+    };
+
+    static const size_t GROUP_COMMIT_BYTES = 64 * 1024;
+    static const int COMMIT_INTERVAL_MS = 20;
+    static const size_t MAX_PENDING_BYTES = 8 * 1024 * 1024;
+
+    // Called for each record found on open, valid only during the call
+    typedef std::function<void(const JournalRecord&)> RecordVisitor;
+
+private:
+    int fd;
+    SyncPolicy policy;
+    std::string path_;
+
+    std::mutex pendingLock;          // Guards everything below
+    std::condition_variable wake;    // Committer: something to write or stop
+    std::condition_variable written; // Flushers: committedBytes moved
+    std::vector<char> pending;       // Encoded records not yet handed to the committer
+    uint64_t appendedBytes;          // Bytes ever appended
+    uint64_t committedBytes;         // Bytes ever written out, or dropped by a failed write
+    uint64_t openedLength;           // Offset the file ended at once opened, before the first append
+    uint64_t firstOffset;            // Offset of the file's first record
+    bool flushRequested;
+    bool committing;                 // The committer is writing outside the lock
+    bool stopping;
+    bool failed;                     // A write failed, later records are dropped
+    std::thread committer;
+
+    void commitLoop();
+
+    // Encode one record into the pending batch, flags as written to the file
+    void appendRecord(const std::string& channel, const std::string& user, const std::string& city,
+                      const std::string& name, int dateTime, unsigned char flags,
+                      const char* description, size_t descriptionLength);
+
+    // Read the offset of a journal's first record from its header. A header torn while it was
+    // written, or missing, reads as a fresh journal. Returns false if the bytes are not a journal.
+    static bool readFirstOffset(const char* data, size_t size, uint64_t& first);
+
+    // Hand the records of a journal's bytes at offsets from skipBytes on to visit, the first at
+    // offset first, setting validLength to the bytes the header and all records span
+    static void replay(const char* data, size_t size, uint64_t first, uint64_t skipBytes,
+                       const RecordVisitor& visit, size_t& validLength, size_t& records);
+
+public:
+    EventJournal();
+    ~EventJournal();
+
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    // Hand every record already in path to visit, drop a torn tail and start appending.
+    // Records before offset skipBytes, already covered by a snapshot, are checked but not visited.
+    // A journal ending before skipBytes lost records the snapshot holds anyway (unsynced writes
+    // at a power loss), so none of it is replayed and it starts afresh at skipBytes.
+    // The file is created if missing. Returns false if it cannot be opened, is not a journal,
+    // or was rolled over past skipBytes, which would lose the records in between.
+    bool open(const std::string& path, SyncPolicy policy, const RecordVisitor& visit, size_t* replayed = nullptr,
+              uint64_t skipBytes = 0);
+
+    // Write out what is pending, stop the committer and close the file
+    void close();
+
+    bool isOpen() const;
+
+    const std::string& path() const;
+
+    // Offset the journal ends at once everything appended so far is written
+    uint64_t size();
+
+    // Queue one event for the next group write, waiting first while the pending buffer is full
+    void append(const std::string& channel, const std::string& user, const std::string& city,
+                const std::string& name, int dateTime, unsigned char generalFlags,
+                const char* description, size_t descriptionLength);
+
+    // Queue the removal of every event user journaled so far
+    void appendClearUser(const std::string& user);
+
+    // Wait until everything appended so far is written and synced to disk, whatever the policy,
+    // so a snapshot can count on it. Returns false if a write or the sync failed.
+    bool flush();
+
+    // Drop the records before offset covered, which a snapshot now holds: the records after it
+    // are copied to a fresh file, synced and renamed over the journal. Appends wait meanwhile.
+    // Returns false, leaving the journal as it was, if that fails.
+    bool rollOver(uint64_t covered);
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "event.h"
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Sorts a stream of events by date time in bounded memory, equal times kept in arrival order.
+// Events gather into a run of runEvents; a full run is sorted and spilled to an anonymous
+// temporary file. finish() merges the spilled runs and the last one with a heap over their
+// next events, so at most one run plus one event per spilled run is held at any time.
+class EventSorter {
+public:
+    static const size_t DEFAULT_RUN_EVENTS = 16384;
+
+    // Called for each event in order, returns false to stop
+    typedef std::function<bool(Event&)> EventVisitor;
+
+    explicit EventSorter(size_t runEvents = DEFAULT_RUN_EVENTS);
+    ~EventSorter();
+
+    EventSorter(const EventSorter&) = delete;
+    EventSorter& operator=(const EventSorter&) = delete;
+
+    // Take an event, spilling the run once it is full.
+    // Throws std::runtime_error if the run cannot be written out.
+    void add(Event& event);
+
+    // Hand every event taken so far to visit in date time order, spilled events coming back
+    // on channel. Returns false if visit stopped it. Throws std::runtime_error if a spilled
+    // run cannot be read back.
+    bool finish(const std::string& channel, const EventVisitor& visit);
+
+    // Runs written to temporary files so far
+    size_t spilledRuns() const;
+
+private:
+    size_t runEvents;
+    std::vector<Event> run;     // The run being gathered
+    std::vector<FILE*> spilled; // Sorted runs, rewound and read front to back by finish()
+
+    void sortRun();
+    void spill();
+};
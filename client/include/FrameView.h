@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Non-owning view of a run of characters (C++11 stand-in for std::string_view).
+// Valid only as long as the bytes it points into.
+struct StringSlice {
+    const char* data;
+    size_t size;
+
+    StringSlice();
+    StringSlice(const char* data, size_t size);
+
+    bool empty() const;
+
+    // Compares against a null-terminated literal
+    bool equals(const char* literal) const;
+    bool startsWith(const char* prefix) const;
+
+    // Slice without the first count characters
+    StringSlice dropPrefix(size_t count) const;
+
+    // Slice without leading and trailing spaces and tabs
+    StringSlice trim() const;
+
+    // Parses a decimal integer, skipping leading whitespace like std::stoi.
+    // Returns false if no digits are found.
+    bool toInt(int& value) const;
+
+    // Copies the slice into an owned string
+    std::string str() const;
+};
+
+// Server frame commands the client understands
+enum class StompCommand {
+    UNKNOWN,
+    CONNECTED,
+    MESSAGE,
+    RECEIPT,
+    ERROR
+};
+
+// Headers the client looks up by name, anything else is only kept in the header list
+enum class StompHeader {
+    UNKNOWN = -1,
+    DESTINATION,
+    SUBSCRIPTION,
+    MESSAGE_ID,
+    RECEIPT_ID,
+    MESSAGE,
+    VERSION,
+    CONTENT_LENGTH,
+    COUNT // Number of known headers
+};
+
+// A received STOMP frame split into slices of the receive buffer.
+// Filled by StompFrameParser without heap allocation; the view is invalidated by the next read.
+// It also keeps the structural marks it was parsed from, so the body can be read without a rescan.
+class FrameView {
+public:
+    static const size_t MAX_HEADERS = 16; // Headers beyond this are ignored
+
+    StringSlice raw;     // The whole frame, without the delimiter
+    StringSlice command; // First line
+    StringSlice body;    // Everything after the blank line ending the headers
+
+    FrameView();
+
+    // Split a frame in one pass over its bytes.
+    // Returns false if the frame has no command line.
+    bool parse(const char* data, size_t size);
+
+    StompCommand type() const;
+
+    size_t headerCount() const;
+    const StringSlice& headerName(size_t index) const;
+    const StringSlice& headerValue(size_t index) const;
+
+    // Known headers are resolved while parsing, so these lookups do not scan
+    bool hasHeader(StompHeader header) const;
+    const StringSlice& header(StompHeader header) const;
+
+    // Finds a header by name, returns false if it is missing
+    bool getHeader(const char* name, StringSlice& value) const;
+
+    // Value of the receipt-id header, -1 if missing or malformed
+    int receiptId() const;
+
+private:
+    friend class StompFrameParser;
+
+    StompCommand commandType;
+    StringSlice headerNames[MAX_HEADERS];
+    StringSlice headerValues[MAX_HEADERS];
+    size_t numHeaders;
+    StringSlice knownHeaders[static_cast<int>(StompHeader::COUNT)];
+    unsigned int knownHeaderMask; // Bit per StompHeader that was present
+    const uint32_t* marks;        // Structural marks of the frame, see StructuralIndex
+    size_t markCount;
+    uint32_t markBase;            // Mark value of the frame's first byte
+    size_t bodyMark;              // First mark inside the body
+
+    void clear();
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Builds outgoing frames by appending straight into one byte buffer.
+// The buffer keeps its capacity across clear(), so a writer reused for every batch of a
+// report stops allocating once it has grown to the largest batch. Each frame written
+// with endFrame() is followed by its null terminator, ready to go on the wire as is.
+class FrameWriter {
+private:
+    std::string buffer; // Finished frames, then the frame being written
+    size_t frames;      // Frames finished since the last clear()
+
+public:
+    static const size_t DEFAULT_CAPACITY = 4096;
+
+    // Longest decimal form of a long, sign included
+    static const size_t MAX_INT_CHARS = 20;
+
+    explicit FrameWriter(size_t capacity = DEFAULT_CAPACITY);
+
+    // Start a frame with its command line
+    FrameWriter& command(const char* name);
+
+    // "name:value" header lines
+    FrameWriter& header(const char* name, const std::string& value);
+    FrameWriter& header(const char* name, long value);
+
+    // Raw bytes, no newline added
+    FrameWriter& append(const std::string& text);
+    FrameWriter& append(const char* data, size_t length);
+    FrameWriter& append(const char* text);
+    FrameWriter& append(char c);
+    FrameWriter& append(long value);
+
+    // Blank line between the headers and the body
+    FrameWriter& endHeaders();
+
+    // Terminate the current frame with a null character
+    void endFrame();
+
+    // Every finished frame, terminators included
+    const char* data() const;
+    size_t size() const;
+    size_t frameCount() const;
+    bool empty() const;
+
+    // Drop the frames, keeping the buffer's capacity
+    void clear();
+
+    // Take the unterminated frame being written as a string, leaving the writer empty.
+    // For frames that go out one at a time through the string based send calls.
+    std::string takeFrame();
+
+    // Write the decimal form of value to out, which must hold MAX_INT_CHARS characters.
+    // Returns the number of characters written, no terminator is added.
+    static size_t formatInt(char* out, long value);
+};
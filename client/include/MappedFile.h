@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file's bytes.
+// Regular files are memory mapped so parsers can read the page cache directly; pipes,
+// stdin ("-") and anything mmap refuses fall back to a buffered read into memory.
+class MappedFile {
+private:
+    const char* data_;         // First byte of the file contents
+    size_t size_;              // Number of bytes in the file
+    void* mapping_;            // mmap'd region, nullptr when the buffer is used
+    std::vector<char> buffer_; // Contents read through the fallback path
+
+    // Read everything from a file descriptor into buffer_
+    bool readAll(int fd);
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map or read the file, "-" means standard input.
+    // Returns false in case the file cannot be opened or read.
+    bool open(const std::string& path);
+
+    // Release the mapping or buffer
+    void close();
+
+    const char* data() const;
+    size_t size() const;
+
+    // Whether the contents come from a memory mapping rather than a buffer
+    bool isMapped() const;
+};
+
+// fsync the directory holding path, so a file just renamed to path survives a power loss.
+// Returns false if the directory cannot be opened or synced.
+bool syncParentDirectory(const std::string& path);
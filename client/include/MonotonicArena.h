@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump-pointer allocator. Memory is carved out of chunks and can only be
+// released all at once, which makes storing many small objects a pointer increment
+// and dropping them a handful of frees. Chunks start small and double up to a cap,
+// so an arena holding a few objects stays small.
+class MonotonicArena {
+private:
+    std::vector<std::unique_ptr<char[]>> chunks; // Every chunk handed out so far
+    char* cursor;                                // Next free byte in the current chunk
+    size_t remaining;                            // Free bytes left in the current chunk
+    size_t nextChunkSize;                        // Size of the next regular chunk
+    size_t maxChunkSize;                         // Cap for chunk growth
+    size_t bytesAllocated;                       // Bytes handed out since the last release
+
+    // Start a new chunk able to hold at least size bytes
+    void grow(size_t size);
+
+public:
+    static const size_t DEFAULT_INITIAL_CHUNK_SIZE = 1024;
+    static const size_t DEFAULT_MAX_CHUNK_SIZE = 64 * 1024;
+
+    explicit MonotonicArena(size_t initialChunkSize = DEFAULT_INITIAL_CHUNK_SIZE,
+                            size_t maxChunkSize = DEFAULT_MAX_CHUNK_SIZE);
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    // Uninitialized memory, valid until release() or destruction
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Copy of an object placed in the arena. Destructors never run, so only
+    // trivially destructible types may be stored.
+    template <typename T>
+    T* create(const T& value) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(value);
+    }
+
+    // Copy of a run of characters, not null-terminated
+    const char* copy(const char* data, size_t length);
+
+    // Free every chunk at once
+    void release();
+
+    size_t getBytesAllocated() const;
+    size_t getChunkCount() const;
+};
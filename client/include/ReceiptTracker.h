@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Receipts awaiting a RECEIPT frame, with the message to print when it arrives.
+// Receipt ids come from an increasing counter, so they index a power-of-two ring
+// directly (id & mask) instead of a tree. Each slot is claimed with a compare-and-swap
+// on its state, so registering and completing never take a lock. A slot still holding
+// a receipt that was never answered is reused once the ring wraps around to it.
+class ReceiptTracker {
+private:
+    enum SlotState : int { EMPTY, WRITING, READY, TAKING };
+
+    struct Slot {
+        std::atomic<int> state;
+        std::atomic<int> id;
+        std::string message;                          // Owned by whoever moved state to WRITING/TAKING
+        std::chrono::steady_clock::time_point sentAt; // When the receipt was registered
+
+        Slot();
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    // Move a slot from one stable state to a transient one, waiting out other writers.
+    // Returns the state it was claimed from.
+    int claim(Slot& slot, int transient, bool fromEmpty) const;
+
+public:
+    static const size_t DEFAULT_CAPACITY = 64; // Plenty for join/exit/logout, small enough for many sessions
+
+    // Capacity is rounded up to a power of two
+    explicit ReceiptTracker(size_t capacity = DEFAULT_CAPACITY);
+
+    ReceiptTracker(const ReceiptTracker&) = delete;
+    ReceiptTracker& operator=(const ReceiptTracker&) = delete;
+
+    // Record a receipt at send time.
+    // Returns false if it replaced an unanswered receipt in the same slot.
+    bool registerReceipt(int id, const std::string& message);
+
+    // Complete a receipt, handing back its message and how long the server took to answer.
+    // Returns false if the id is not outstanding.
+    bool take(int id, std::string& message, std::chrono::microseconds& roundTrip);
+    bool take(int id, std::string& message);
+
+    // Checks if a receipt is outstanding
+    bool contains(int id) const;
+
+    // Forget every outstanding receipt
+    void clear();
+
+    size_t capacity() const;
+};
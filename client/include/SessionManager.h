@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ConnectionHandler.h"
+#include "FrameWriter.h"
+#include "StompProtocol.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One logged in identity: its own protocol state (counters, subscriptions, receipts, events)
+// and its connection. Received frames are processed as completion handlers on the
+// SessionManager's io threads, one at a time per session.
+class Session {
+public:
+    // Called for each completed receipt with the time the server took to answer
+    typedef std::function<void(int receiptId, std::chrono::microseconds roundTrip)> ReceiptHandler;
+    // Called after each received frame has been processed
+    typedef std::function<void(const FrameView&)> FrameObserver;
+
+    // Messages for the user go to output, nothing is printed if it is null.
+    // receiptCapacity sizes the ring of outstanding receipts.
+    static std::shared_ptr<Session> create(boost::asio::io_service& ioService, std::ostream* output,
+                                           size_t receiptCapacity = ReceiptTracker::DEFAULT_CAPACITY);
+
+    Session(boost::asio::io_service& ioService, std::ostream* output, size_t receiptCapacity);
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    // Connect to the server (blocking) and start reading, replacing any previous connection.
+    // Returns false if the connection could not be made.
+    bool connect(const std::string& host, short port);
+
+    // Send CONNECT for username, the reply arrives asynchronously.
+    // Returns false if the frame could not be sent.
+    bool login(const std::string& username, const std::string& password);
+
+    // Queue frames for writing, onSent (if given) runs on an io thread once they are out
+    void send(std::vector<std::string> frames, ConnectionHandler::SendHandler onSent = ConnectionHandler::SendHandler());
+    void send(std::string frame, ConnectionHandler::SendHandler onSent = ConnectionHandler::SendHandler());
+
+    // Queue frames and wait until they are written, so a failed send can be reported and a
+    // long report is throttled by the socket. The frames are taken.
+    // Must not be called from an io thread. Returns false if the write failed.
+    bool sendAndWait(std::vector<std::string>& frames);
+    bool sendAndWait(const std::string& frame);
+
+    // Send the writer's frames straight from its buffer and wait until they are written
+    bool sendAndWait(const FrameWriter& writer);
+
+    // Drop the logged in client's state and close the connection
+    void reset();
+
+    // Close the connection without touching the protocol state
+    void close();
+
+    // Handle a frame received from the server
+    void processFrame(const FrameView& frame);
+
+    void setReceiptHandler(ReceiptHandler handler);
+    void setFrameObserver(FrameObserver observer);
+
+    // Whether received MESSAGE events are stored for summaries, on by default.
+    // Sessions that only generate traffic turn it off so memory stays flat.
+    void setKeepEvents(bool keep);
+
+    StompProtocol& getProtocol();
+    std::string getUser() const; // The user of the last login, empty before it
+    bool isConnected() const; // Physical connection
+    bool isLoggedIn() const;  // CONNECTED received and not logged out since
+
+private:
+    boost::asio::io_service& ioService;
+    std::ostream* output;
+    StompProtocol protocol;
+    std::shared_ptr<ConnectionHandler> connection;
+    mutable std::mutex userLock; // Guards user, set by login on the caller's thread and read on io threads
+    std::string user;
+    std::atomic<bool> connected;
+    bool keepEvents;            // Set before login, read on io threads
+    ReceiptHandler onReceipt;   // Set before login, read on io threads
+    FrameObserver onFrame;      // Set before login, read on io threads
+    std::weak_ptr<Session> self; // Set by create(), the connection's handlers must not outlive the session
+
+    void startReading();
+};
+
+// Hosts many independent sessions on a shared pool of io threads.
+// An idle logged in session measured 11-14 KiB resident (StompLoadGen reports it on each run),
+// so thousands fit in one process.
+class SessionManager {
+public:
+    // threadCount io threads, at least one
+    explicit SessionManager(size_t threadCount = 1);
+    ~SessionManager();
+
+    SessionManager(const SessionManager&) = delete;
+    SessionManager& operator=(const SessionManager&) = delete;
+
+    // Add a session, see Session for output and receiptCapacity
+    std::shared_ptr<Session> createSession(std::ostream* output = nullptr,
+                                           size_t receiptCapacity = ReceiptTracker::DEFAULT_CAPACITY);
+
+    // Close a session's connection and forget it
+    void removeSession(const std::shared_ptr<Session>& session);
+
+    // Sessions currently hosted
+    std::vector<std::shared_ptr<Session>> getSessions() const;
+    size_t sessionCount() const;
+
+    boost::asio::io_service& getIoService();
+
+    // Close every session and join the io threads, called by the destructor
+    void stop();
+
+private:
+    boost::asio::io_service ioService;
+    std::unique_ptr<boost::asio::io_service::work> keepRunning; // Keeps run() going while no I/O is pending
+    std::vector<std::thread> ioThreads;
+    mutable std::mutex sessionsLock;
+    std::vector<std::shared_ptr<Session>> sessions;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Reader-writer spin lock for short critical sections (C++11 stand-in for std::shared_mutex).
+// Readers only bump a counter, so concurrent lookups never block each other. A waiting
+// writer holds off new readers so it cannot be starved by a steady stream of lookups.
+// Satisfies Lockable, so std::lock_guard works for the exclusive side.
+class SharedMutex {
+private:
+    static const unsigned WRITER = 1u << 31;  // Held exclusively
+    static const unsigned WAITING = 1u << 30; // A writer is waiting for readers to leave
+
+    std::atomic<unsigned> state; // Reader count in the low bits
+
+public:
+    SharedMutex() : state(0) {}
+
+    SharedMutex(const SharedMutex&) = delete;
+    SharedMutex& operator=(const SharedMutex&) = delete;
+
+    void lock() {
+        while (true) {
+            unsigned current = state.load(std::memory_order_relaxed);
+            if ((current & ~WAITING) == 0) {
+                if (state.compare_exchange_weak(current, WRITER, std::memory_order_acquire)) {
+                    return;
+                }
+                continue;
+            }
+            if (!(current & WAITING)) {
+                state.compare_exchange_weak(current, current | WAITING, std::memory_order_relaxed);
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() {
+        state.fetch_and(~WRITER, std::memory_order_release);
+    }
+
+    void lock_shared() {
+        while (true) {
+            unsigned current = state.load(std::memory_order_relaxed);
+            if (current & (WRITER | WAITING)) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (state.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+                return;
+            }
+        }
+    }
+
+    void unlock_shared() {
+        state.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+// Scoped read lock. Plain mutexes have no shared side, so readers lock them exclusively.
+template <typename Mutex>
+class ReadLockGuard {
+private:
+    Mutex& mutex;
+
+public:
+    explicit ReadLockGuard(Mutex& mutex) : mutex(mutex) { mutex.lock(); }
+    ~ReadLockGuard() { mutex.unlock(); }
+
+    ReadLockGuard(const ReadLockGuard&) = delete;
+    ReadLockGuard& operator=(const ReadLockGuard&) = delete;
+};
+
+template <>
+class ReadLockGuard<SharedMutex> {
+private:
+    SharedMutex& mutex;
+
+public:
+    explicit ReadLockGuard(SharedMutex& mutex) : mutex(mutex) { mutex.lock_shared(); }
+    ~ReadLockGuard() { mutex.unlock_shared(); }
+
+    ReadLockGuard(const ReadLockGuard&) = delete;
+    ReadLockGuard& operator=(const ReadLockGuard&) = delete;
+};
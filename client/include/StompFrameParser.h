@@ -0,0 +1,60 @@
+#pragma once
+
+#include "FrameView.h"
+#include <map>
+#include <string>
+
+// Fields of an event report carried in a MESSAGE body
+enum class EventField {
+    UNKNOWN,
+    DESTINATION,
+    USER,
+    CITY,
+    EVENT_NAME,
+    DATE_TIME,
+    GENERAL_INFORMATION,
+    DESCRIPTION
+};
+
+// An event report read from a MESSAGE body.
+// Single-line fields are slices of the frame; the rest is copied since it becomes part of an Event.
+struct EventReportView {
+    StringSlice channel;
+    StringSlice user;
+    StringSlice city;
+    StringSlice eventName;
+    int dateTime;
+    std::string description;
+    std::map<std::string, std::string> generalInformation;
+
+    EventReportView();
+};
+
+// STOMP 1.2 frame parser built on a StructuralIndex.
+// Lines and header separators are found by jumping between the newline and colon marks
+// of one vectorized scan, and command and header names are resolved by length and first
+// character instead of repeated prefix searches.
+class StompFrameParser {
+public:
+    // Parse a frame (without its delimiter) into a view over the same bytes.
+    // The frame is indexed into per-thread scratch, so the view's body can be read until
+    // the next parse on this thread. Returns false if the frame has no command line.
+    static bool parse(const char* data, size_t size, FrameView& frame);
+
+    // Parse a frame that was already indexed. marks holds, in order, the mark of every
+    // '\n' and ':' in data[0, size), where byte i has mark markBase + i; other marks are
+    // skipped. The marks must stay valid as long as the view.
+    static bool parse(const char* data, size_t size, const uint32_t* marks, size_t markCount, uint32_t markBase,
+                      FrameView& frame);
+
+    // Read the event report carried in a MESSAGE frame's body.
+    // The destination header provides the channel.
+    static void parseEventReport(const FrameView& frame, EventReportView& report);
+
+    static StompCommand classifyCommand(const char* name, size_t length);
+    static StompHeader classifyHeader(const char* name, size_t length);
+    static EventField classifyEventField(const char* name, size_t length);
+
+private:
+    static void addHeader(FrameView& frame, const StringSlice& name, const StringSlice& value);
+};
@@ -6,9 +6,11 @@
 #include "../include/event.h"
 #include <vector>
 #include "ConcurrentHashMap.h"
-#include "ConcurrentHashMapReversed.h"
+#include "FrameWriter.h"
+#include "ReceiptTracker.h"
 #include "SummaryManager.h"
 #include <map>
+#include <functional>
 
 
 
@@ -19,11 +21,11 @@ private:
     std::atomic<int> subscriptionCounter; // Thread-safe counter for unique subscription IDs
 
 public:
-    StompProtocol();
+    explicit StompProtocol(size_t receiptCapacity = ReceiptTracker::DEFAULT_CAPACITY);
     std::atomic<bool> isLogicConnected;
     std::atomic<int> sentDisconnect;
     ConcurrentHashMap channelToSubcriptonID; 
-    ConcurrentHashMapReversed receiptIDToMessageMap;
+    ReceiptTracker receiptTracker;        // Messages to print when each receipt arrives
 
 
     // Frame constructors
@@ -32,11 +34,32 @@ public:
     std::string constructUnsubscribeFrame(const std::string& channel);
     std::string constructDisconnectFrame();
     std::vector<std::string> constructReportFrames(const std::string& filePath, const std::string& userNameOK);
+
+    // Receives a batch of ready frames, done with them once it returns. Returns false to stop the report
+    typedef std::function<bool(const FrameWriter&)> FrameSink;
+
+    // Build the report's SEND frames in date time order, in batches of batchSize, and hand each
+    // batch to the sink as soon as it is ready, so the whole report is never held as frames at once.
+    // Events are streamed from the file into an EventSorter, so neither are they held as Events.
+    // Every batch is written into the same buffer, which stops growing after the largest one.
+    // A blocking sink (e.g. a socket write) throttles frame construction.
+    // Every event is added to the summary, also after the sink stopped the report.
+    // Returns false if the sink stopped the report. Parse throughput is written to stats if given.
+    bool streamReportFrames(const std::string& filePath, const std::string& userNameOK,
+                            size_t batchSize, const FrameSink& sink, parse_stats* stats = nullptr);
     SummaryManager& getSummaryManager(); // Access summary manager
 
     // Process server responses
     void processFrame(const std::string& frame);
 
+    // Build the SEND frame reporting one event, the receipt id it carries is written to receiptId if given
+    std::string constructReportFrame(const std::string& channel, const std::string& userNameOK, const Event& event,
+                                     int* receiptId = nullptr);
+
+    // Append that SEND frame to writer, terminated
+    void writeReportFrame(FrameWriter& writer, const std::string& channel, const std::string& userNameOK,
+                          const Event& event, int* receiptId = nullptr);
+
 private:
     int getNextReceiptId();       // Helper function to generate unique receipt IDs
     int getNextSubscriptionId();  // Helper function to generate unique subscription IDs
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+#include <mutex>
+
+// An interned string. Equal strings share one Symbol, so comparing names is a pointer compare
+// and storing one is a single pointer instead of a heap-allocated copy.
+typedef const std::string* Symbol;
+
+// Process-wide pool of interned strings.
+// Channel, city, user and event names repeat across thousands of events, so each distinct
+// value is stored once and kept for the lifetime of the process.
+class StringInterner {
+private:
+    std::unordered_set<std::string> strings; // Node based, element addresses never move
+    mutable std::mutex internLock;
+
+    StringInterner();
+
+public:
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    // The shared pool
+    static StringInterner& instance();
+
+    // Returns the Symbol for a string, adding it on first use
+    Symbol intern(const std::string& value);
+    Symbol intern(const char* data, size_t length);
+
+    // Sets symbol to the Symbol of value without adding it. Returns false if value was never interned.
+    bool find(const std::string& value, Symbol& symbol) const;
+
+    // Symbol of the empty string
+    static Symbol empty();
+
+    // Number of distinct strings interned so far
+    size_t size() const;
+};
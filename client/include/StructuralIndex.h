@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Offsets of the bytes that give a STOMP frame its structure: the frame delimiter,
+// newlines and colons. One vectorized pass over the received bytes finds all three, and
+// the frame splitter, header parser and event report parser then jump from mark to mark
+// instead of testing every byte again.
+// The scan kernel is picked once at runtime: AVX2 where the CPU has it, SSE2 on other
+// x86-64 machines and a portable byte loop elsewhere.
+class StructuralIndex {
+public:
+    enum Kernel {
+        AUTO,   // Best the CPU supports
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    StructuralIndex();
+
+    StructuralIndex(const StructuralIndex&) = delete;
+    StructuralIndex& operator=(const StructuralIndex&) = delete;
+
+    // Append the offset of every delimiter, '\n' and ':' in data[0, size), each plus base
+    void scan(const char* data, size_t size, char delimiter, uint32_t base = 0);
+
+    const uint32_t* data() const;
+    size_t size() const;
+    uint32_t operator[](size_t index) const;
+
+    // Forget the marks before index
+    void dropFront(size_t index);
+
+    // Subtract offset from every mark, after the bytes they index moved down by that much
+    void shift(uint32_t offset);
+
+    void clear();
+
+    // Use kernel for every later scan in the process, false if the CPU cannot run it.
+    // Meant for benchmarks, AUTO goes back to the best one.
+    static bool selectKernel(Kernel kernel);
+
+    // Name of the kernel in use: "avx2", "sse2" or "scalar"
+    static const char* kernelName();
+
+private:
+    std::unique_ptr<uint32_t[]> marks; // Grown by hand, a vector would zero what the kernels overwrite
+    size_t count;
+    size_t capacity;
+
+    // Append the offsets of the set bits of a 64-byte block's match mask
+    void appendMask(uint64_t mask, uint32_t blockBase);
+
+    void reserve(size_t required);
+};
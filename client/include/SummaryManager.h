@@ -1,25 +1,213 @@
 #pragma once
 
 #include "event.h"
+#include "ColumnStore.h"
+#include "EventJournal.h"
+#include "MappedFile.h"
+#include "MonotonicArena.h"
+#include "StringInterner.h"
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <future>
+#include <functional>
+
+// Compact copy of an Event kept for summaries: interned names, the general information
+// flags as bits, and the description stored in its bucket's arena.
+struct StoredEvent {
+    Symbol city;
+    Symbol name;
+    int dateTime;
+    unsigned char generalFlags;  // GeneralInformationFlag bits
+    const char* description;     // Not null-terminated
+    size_t descriptionLength;
+};
+
+// A bucket's events in summary order, with the stats counted as they arrive,
+// so a summary is written straight from it.
+struct EventIndex {
+    std::vector<const StoredEvent*> events; // By date time then event name, ties in arrival order
+    int activeCount;
+    int forcesArrivalCount;
+
+    EventIndex();
+
+    // Place an event in order and count it
+    void insert(const StoredEvent* event);
+};
+
+// Events one user reported on one channel.
+// Records and their description text are bump-allocated in the bucket's own arena,
+// so dropping the bucket frees them a chunk at a time. Records never move once placed.
+// The index is copy-on-write: a summary keeps the index it started with while new
+// events go into a fresh copy, so the summary can be written without the lock.
+// Events loaded from a snapshot keep their description in its mapping instead of the arena.
+struct EventBucket {
+    MonotonicArena arena;
+    std::shared_ptr<EventIndex> index;
+    std::vector<std::shared_ptr<const MappedFile>> snapshots; // Snapshots loaded descriptions point into
+
+    EventBucket();
+
+    // Add an event, copying the index first if a summary still holds it. Call under the lock.
+    void insert(const StoredEvent* event);
+};
+
+// An event in some bucket, with the user who reported it
+struct IndexedEvent {
+    Symbol user;
+    const StoredEvent* event;
+};
+
+// Every user's events on one channel, for queries across users.
+// Entries sit in contiguous blocks of at most BLOCK_EVENTS, each sorted by date time with ties
+// in arrival order and carrying its earliest and latest time; the blocks are in time order, so
+// a time range is a binary search over them. The city and user indexes only list the blocks
+// holding a city's or a user's events, so a city query or a user's removal touches just those.
+// Entries point into the buckets' arenas and are removed before their bucket is dropped.
+class ChannelIndex {
+public:
+    static const size_t BLOCK_EVENTS = 256;
+
+    typedef std::function<void(const IndexedEvent&)> EntryVisitor;
+
+    ChannelIndex();
+
+    void insert(Symbol user, const StoredEvent* event);
+
+    // Drop every entry reported by user
+    void removeUser(Symbol user);
+
+    // Every entry in time order
+    void forEach(const EntryVisitor& visit) const;
+
+    // Entries dated from..to inclusive, in time order
+    void forEachBetween(int from, int to, const EntryVisitor& visit) const;
+
+    // The latest count entries in city, newest first
+    void forEachLatestInCity(Symbol city, size_t count, const EntryVisitor& visit) const;
+
+private:
+    struct Block {
+        std::vector<IndexedEvent> events; // By date time, ties in arrival order
+        int minTime;
+        int maxTime;
+        size_t position;            // In blocks
+        std::vector<Symbol> users;  // Each user with an entry here, once
+        std::vector<Symbol> cities; // Each city with an entry here, once
+
+        explicit Block(size_t position);
+    };
+
+    typedef std::unordered_map<Symbol, std::vector<Block*>> BlockRefs;
+
+    std::vector<std::unique_ptr<Block>> blocks; // In time order
+    BlockRefs userBlocks;                       // User -> blocks holding their entries
+    BlockRefs cityBlocks;                       // City -> blocks holding its entries
+
+    // Record that block holds an entry of user in city
+    void note(Block& block, Symbol user, Symbol city);
+    // Forget block in the user and city indexes
+    void unlink(Block& block);
+    // Recount block's times, users and cities after its entries changed
+    void summarize(Block& block);
+    void split(Block& block);
+    void renumber(size_t from);
+    static void dropRef(BlockRefs& refs, Symbol symbol, Block* block);
+};
+
+// A query result, copied out of the store so it can be used without the lock
+struct EventRecord {
+    Symbol user;
+    Symbol city;
+    Symbol name;
+    int dateTime;
+    std::string description;
+};
 
 class SummaryManager {
 private:
-    std::map<std::string, std::map<std::string, std::vector<Event>>> channelData; // Channel -> User -> Events
-    mutable std::mutex summaryLock; // For thread-safe access
+    // Shared so a summary in progress keeps a dropped bucket's arena alive
+    std::map<std::string, std::map<std::string, std::shared_ptr<EventBucket>>> channelData; // Channel -> User -> Events
+    std::map<std::string, ChannelIndex> channelIndex; // Channel -> all users' events, by time and by city
+    std::map<std::string, ColumnStore> channelColumns; // Channel -> its events as columns, while columnar is on
+    bool columnar;
+    EventJournal journal; // Every added event, when open
+    std::future<bool> snapshotWrite; // The snapshot being written in the background, if any
+    mutable std::mutex summaryLock; // Guards channelData and the indexes, held only briefly by summaries and queries
+
+    static EventRecord toRecord(const IndexedEvent& indexed);
+
+    // Copy event's description into the bucket's arena and index the copy. Call under the lock.
+    void place(EventBucket& bucket, ChannelIndex& index, ColumnStore* columns, Symbol user, const StoredEvent& event);
+
+    // Add an event already in the bucket's memory to the bucket and the channel's indexes
+    void link(EventBucket& bucket, ChannelIndex& index, ColumnStore* columns, Symbol user, const StoredEvent* placed);
 
-    std::string epochToDate(int epochTime) const; // Convert epoch time to DD/MM/YYYY HH:MM
+    // Drop every event user reported, on every channel. Call under the lock.
+    void dropUser(const std::string& user);
 
 public:
+    static const size_t MAX_HISTOGRAM_BUCKETS = 10000; // Keeps a histogram's result small whatever is asked
+
     SummaryManager();
     ~SummaryManager();
 
     void addEvent(const std::string& channel, const std::string& user, const Event& event); // Add an event
-    void generateSummary(const std::string& channel, const std::string& user, const std::string& filePath) const; // Generate summary
+    // Add an event handed over by the caller, freeing its description and general information
+    // as soon as it is stored rather than whenever the caller would have dropped it
+    void addEvent(const std::string& channel, const std::string& user, Event&& event);
+    // Write the summary from a snapshot taken under the lock, events keep arriving meanwhile
+    void generateSummary(const std::string& channel, const std::string& user, const std::string& filePath) const;
+    // Events any user reported on channel with from <= date time <= to, oldest first.
+    // O(log n + k) for k results.
+    std::vector<EventRecord> eventsBetween(const std::string& channel, int from, int to) const;
+
+    // The count latest events on channel in city, oldest first. O(log n + count).
+    std::vector<EventRecord> latestInCity(const std::string& channel, const std::string& city, size_t count) const;
+
+    // Also keep every channel's events as columns for the analytics below, off by default.
+    // Turning it on loads the events already stored, turning it off drops the columns.
+    void setColumnar(bool enabled);
+    bool isColumnar() const;
+
+    // Channel wide analytics, over nothing unless columnar is on
+    ColumnCounts channelCounts(const std::string& channel) const;
+    std::vector<std::pair<Symbol, size_t>> countByCity(const std::string& channel) const;
+    // Event counts in buckets consecutive windows of bucketSeconds starting at from.
+    // Empty if more than MAX_HISTOGRAM_BUCKETS are asked for.
+    std::vector<size_t> histogram(const std::string& channel, int from, int bucketSeconds, size_t buckets) const;
+
+    // Load the events journaled at path, then journal every event added from now on, so a
+    // restarted client can still summarize them. Events already in memory are kept but not
+    // journaled. clearClientData journals the user's removal, so replay ends with the events
+    // the client held when it stopped, as a snapshot does. clear() leaves the journal as it is.
+    // Returns false if the journal cannot be opened. The replayed event count goes to replayed.
+    // The first skipBytes of the journal are left out, see loadSnapshot.
+    bool openJournal(const std::string& path, EventJournal::SyncPolicy policy, size_t* replayed = nullptr,
+                     uint64_t skipBytes = 0);
+
+    // Write every stored event to a snapshot at path on a background thread. The view is taken
+    // under the lock from the copy-on-write bucket indexes, so events keep arriving meanwhile.
+    // With rollJournal, once the snapshot is in place the journal records it covers are dropped,
+    // and from then on the journal only restores on top of this snapshot.
+    // Returns false if a snapshot is still being written.
+    bool writeSnapshot(const std::string& path, bool rollJournal = true);
+
+    // Wait for the snapshot in progress, false if writing it failed
+    bool waitForSnapshot();
+
+    // Add the events of the snapshot at path. A missing file adds nothing and succeeds.
+    // journalOffset gets the journal offset the snapshot covers, to pass to openJournal.
+    // Returns false if the file is not a snapshot this version can read.
+    bool loadSnapshot(const std::string& path, uint64_t* journalOffset = nullptr, size_t* loaded = nullptr);
+
+    std::string epochToDate(int64_t epochTime) const; // Convert epoch time to DD/MM/YYYY HH:MM
+
     void clear(); // Clear all stored events
-    void clearClientData(const std::string& clientName);
+    void clearClientData(const std::string& clientName); // Drop a user's events, journaling the removal
 
 };
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "SummaryManager.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One user's events on one channel as a snapshot sees them: the bucket keeps the
+// records alive, the index is the copy-on-write version taken under the lock.
+struct SnapshotBucket {
+    Symbol user;
+    std::shared_ptr<const EventBucket> bucket;
+    std::shared_ptr<const EventIndex> index;
+};
+
+struct SnapshotChannel {
+    std::string name;
+    std::vector<SnapshotBucket> buckets;
+
+    SnapshotChannel();
+};
+
+// Versioned binary image of SummaryManager's events, in host byte order:
+//   header        magic, version, counts, the journal length it covers and section offsets
+//   string tables channels, users, cities and event names, each a uint32 length and the bytes
+//   channels      event count of each channel, in channel table order
+//   events        fixed 32 byte records, channel by channel in time order: date time, flags,
+//                 user, city and name ids, and the description's offset and length in the blob
+//   blob          every description back to back
+// Loading maps the file and decodes the fixed records only. Descriptions are left in the
+// mapping and point straight into it, so their pages are read when a summary touches them.
+// Snapshots are written to a temporary file, synced and renamed into place, and the directory
+// is synced after the rename, so a crash leaves the previous snapshot whole and readers of it
+// keep their mapping.
+class SummarySnapshot {
+private:
+    std::shared_ptr<MappedFile> file;
+    uint64_t journalOffset_;
+    uint64_t eventCount_;
+    std::vector<Symbol> channels;
+    std::vector<Symbol> users;
+    std::vector<Symbol> cities;
+    std::vector<Symbol> names;
+    std::vector<uint64_t> channelEvents; // Event count of each channel
+    const char* events;                  // First fixed record
+    const char* blob;                    // First description byte
+
+public:
+    static const uint32_t VERSION = 1;
+
+    // Called for each event, description pointing into the snapshot's mapping
+    typedef std::function<void(Symbol channel, Symbol user, const StoredEvent& event)> EventVisitor;
+
+    SummarySnapshot();
+
+    SummarySnapshot(const SummarySnapshot&) = delete;
+    SummarySnapshot& operator=(const SummarySnapshot&) = delete;
+
+    // Write the events of view to path. Within a channel the buckets are merged by date time,
+    // equal times in bucket order. journalOffset is the journal length the events cover.
+    // Returns false if the file cannot be written.
+    static bool write(const std::string& path, const std::vector<SnapshotChannel>& view, uint64_t journalOffset);
+
+    // Map path and check every section and record against the header.
+    // Returns false if it cannot be read, is not a snapshot or has another version.
+    bool open(const std::string& path);
+
+    // Hand every event to visit, channel by channel in time order
+    void forEachEvent(const EventVisitor& visit) const;
+
+    uint64_t journalOffset() const;
+    uint64_t eventCount() const;
+
+    // The mapping loaded descriptions point into, to be held as long as they are used
+    std::shared_ptr<const MappedFile> backing() const;
+};
@@ -4,38 +4,74 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <functional>
+#include "StringInterner.h"
+
+// bits of the general information flags every event carries
+enum GeneralInformationFlag : unsigned char
+{
+    ACTIVE_PRESENT = 1 << 0,
+    ACTIVE_TRUE = 1 << 1,
+    FORCES_ARRIVAL_PRESENT = 1 << 2,
+    FORCES_ARRIVAL_TRUE = 1 << 3
+};
 
 class Event
 {
 private:
     // name of channel
-    std::string channel_name;
+    Symbol channel_name;
     // city of the event 
-    std::string city;
+    Symbol city;
     // name of the event
-    std::string name;
+    Symbol name;
     // time of the event in seconds
     int date_time;
     // description of the event
     std::string description;
-    // map of all the general information
-    std::map<std::string, std::string> general_information;
-    std::string eventOwnerUser;
+    // "active" and "forces_arrival_at_scene" when they hold true/false, see GeneralInformationFlag
+    unsigned char general_flags;
+    // any other general information, sorted by key
+    std::vector<std::pair<std::string, std::string>> extra_information;
+    Symbol eventOwnerUser;
+
+    void set_general_information(std::map<std::string, std::string> &general_information);
 
 public:
     void split_str(const std::string &input, char delimiter, std::vector<std::string> &output);
     
     Event(std::string channel_name, std::string city, std::string name, int date_time, std::string description, std::map<std::string, std::string> general_information);
     Event(const std::string & frame_body);
+    // events are move-only: the ingestion chain (file -> Event -> names_and_events ->
+    // SummaryManager) hands each one over instead of copying it
+    Event(const Event &other) = delete;
+    Event &operator=(const Event &other) = delete;
+    Event(Event &&other) = default;
+    Event &operator=(Event &&other) = default;
     virtual ~Event();
     void setEventOwnerUser(std::string setEventOwnerUser);
+    void set_channel_name(const std::string &channel_name);
     const std::string &getEventOwnerUser() const;
     const std::string &get_channel_name() const;
     const std::string &get_city() const;
     const std::string &get_description() const;
     const std::string &get_name() const;
     int get_date_time() const;
-    const std::map<std::string, std::string> &get_general_information() const;
+
+    // interned names, cheap to store and compare
+    Symbol channel_symbol() const;
+    Symbol city_symbol() const;
+    Symbol name_symbol() const;
+
+    unsigned char get_general_flags() const;
+    bool is_active() const;
+    bool is_forces_arrival_at_scene() const;
+
+    // calls visit for every general information entry, in key order
+    void for_each_general_information(const std::function<void(const std::string &, const std::string &)> &visit) const;
+
+    // general information rebuilt as a map
+    std::map<std::string, std::string> get_general_information() const;
 };
 
 // an object that holds the names of the teams and a vector of events, to be returned by the parseEventsFile function
@@ -44,5 +80,22 @@ struct names_and_events {
     std::vector<Event> events;
 };
 
+// throughput of reading an events file
+struct parse_stats {
+    size_t bytes;    // bytes of JSON consumed
+    size_t events;   // events produced
+    double seconds;  // wall time spent parsing
+
+    double megabytes_per_second() const;
+    double events_per_second() const;
+};
+
 // function that parses the json file and returns a names_and_events object
-names_and_events parseEventsFile(std::string json_path);
+names_and_events parseEventsFile(std::string json_path, parse_stats *stats = nullptr);
+
+// function that streams the events of a json file to on_event one at a time, without
+// building the whole JSON document, and returns the channel name.
+// regular files are memory mapped, "-" reads standard input.
+// events that appear before "channel_name" in the file are held until it is read.
+std::string parseEventsFileStreaming(const std::string &json_path, const std::function<void(Event &)> &on_event,
+                                     parse_stats *stats = nullptr);
@@ -0,0 +1,153 @@
+#include "../include/ColumnStore.h"
+#include "../include/event.h"
+
+SymbolDictionary::SymbolDictionary() : symbols(), ids() {}
+
+uint32_t SymbolDictionary::encode(Symbol symbol) {
+    auto found = ids.find(symbol);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    uint32_t id = static_cast<uint32_t>(symbols.size());
+    symbols.push_back(symbol);
+    ids.insert(std::make_pair(symbol, id));
+    return id;
+}
+
+bool SymbolDictionary::find(Symbol symbol, uint32_t& id) const {
+    auto found = ids.find(symbol);
+    if (found == ids.end()) {
+        return false;
+    }
+    id = found->second;
+    return true;
+}
+
+Symbol SymbolDictionary::decode(uint32_t id) const {
+    return symbols[id];
+}
+
+size_t SymbolDictionary::size() const {
+    return symbols.size();
+}
+
+void SymbolDictionary::clear() {
+    symbols.clear();
+    ids.clear();
+}
+
+ColumnStore::ColumnStore()
+    : dateTimes(), cityIds(), nameIds(), userIds(), activeBits(), forcesArrivalBits(), cities(), names(), users() {}
+
+void ColumnStore::setBit(std::vector<uint64_t>& bits, size_t row, bool value) {
+    if (row / 64 >= bits.size()) {
+        bits.push_back(0);
+    }
+    if (value) {
+        bits[row / 64] |= uint64_t(1) << (row % 64);
+    }
+}
+
+void ColumnStore::append(Symbol user, Symbol city, Symbol name, int dateTime, unsigned char generalFlags) {
+    size_t row = dateTimes.size();
+    dateTimes.push_back(dateTime);
+    cityIds.push_back(cities.encode(city));
+    nameIds.push_back(names.encode(name));
+    userIds.push_back(users.encode(user));
+    setBit(activeBits, row, (generalFlags & ACTIVE_TRUE) != 0);
+    setBit(forcesArrivalBits, row, (generalFlags & FORCES_ARRIVAL_TRUE) != 0);
+}
+
+void ColumnStore::removeUser(Symbol user) {
+    uint32_t removed;
+    if (!users.find(user, removed)) {
+        return;
+    }
+
+    // Compact every column in place, the bitsets are rebuilt as rows move down
+    std::vector<uint64_t> oldActive, oldForcesArrival;
+    oldActive.swap(activeBits);
+    oldForcesArrival.swap(forcesArrivalBits);
+    size_t kept = 0;
+    for (size_t row = 0; row < dateTimes.size(); ++row) {
+        if (userIds[row] == removed) {
+            continue;
+        }
+        dateTimes[kept] = dateTimes[row];
+        cityIds[kept] = cityIds[row];
+        nameIds[kept] = nameIds[row];
+        userIds[kept] = userIds[row];
+        setBit(activeBits, kept, (oldActive[row / 64] >> (row % 64)) & 1);
+        setBit(forcesArrivalBits, kept, (oldForcesArrival[row / 64] >> (row % 64)) & 1);
+        ++kept;
+    }
+    dateTimes.resize(kept);
+    cityIds.resize(kept);
+    nameIds.resize(kept);
+    userIds.resize(kept);
+}
+
+size_t ColumnStore::size() const {
+    return dateTimes.size();
+}
+
+void ColumnStore::clear() {
+    dateTimes.clear();
+    cityIds.clear();
+    nameIds.clear();
+    userIds.clear();
+    activeBits.clear();
+    forcesArrivalBits.clear();
+    cities.clear();
+    names.clear();
+    users.clear();
+}
+
+ColumnCounts ColumnStore::counts() const {
+    // Bits past the last row are never set, so whole words can be counted
+    size_t active = 0, forcesArrival = 0, both = 0;
+    const uint64_t* activeWords = activeBits.data();
+    const uint64_t* forcesWords = forcesArrivalBits.data();
+    for (size_t i = 0; i < activeBits.size(); ++i) {
+        active += __builtin_popcountll(activeWords[i]);
+        forcesArrival += __builtin_popcountll(forcesWords[i]);
+        both += __builtin_popcountll(activeWords[i] & forcesWords[i]);
+    }
+    ColumnCounts result = {dateTimes.size(), active, forcesArrival, both};
+    return result;
+}
+
+std::vector<std::pair<Symbol, size_t>> ColumnStore::countByCity() const {
+    std::vector<size_t> perId(cities.size(), 0);
+    const uint32_t* ids = cityIds.data();
+    for (size_t row = 0; row < cityIds.size(); ++row) {
+        ++perId[ids[row]];
+    }
+
+    std::vector<std::pair<Symbol, size_t>> result;
+    for (uint32_t id = 0; id < perId.size(); ++id) {
+        if (perId[id] != 0) {
+            result.push_back(std::make_pair(cities.decode(id), perId[id]));
+        }
+    }
+    return result;
+}
+
+std::vector<size_t> ColumnStore::histogram(int from, int bucketSeconds, size_t buckets) const {
+    std::vector<size_t> result(buckets, 0);
+    if (bucketSeconds <= 0 || buckets == 0) {
+        return result;
+    }
+    // Offsets are taken in 64 bits so a wide range cannot overflow
+    const int64_t start = from;
+    const int64_t width = bucketSeconds;
+    const int64_t span = width * static_cast<int64_t>(buckets);
+    const int32_t* times = dateTimes.data();
+    for (size_t row = 0; row < dateTimes.size(); ++row) {
+        int64_t offset = times[row] - start;
+        if (offset >= 0 && offset < span) {
+            ++result[offset / width];
+        }
+    }
+    return result;
+}
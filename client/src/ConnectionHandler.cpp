@@ -1,4 +1,7 @@
 #include "../include/ConnectionHandler.h"
+#include "../include/StompFrameParser.h"
+#include <algorithm>
+#include <cstring>
 
 using boost::asio::ip::tcp;
 
@@ -8,8 +11,31 @@ using std::cerr;
 using std::endl;
 using std::string;
 
-ConnectionHandler::ConnectionHandler(string host, short port) : host_(host), port_(port), io_service_(),
-                                                                socket_(io_service_) {}
+ConnectionHandler::ConnectionHandler(string host, short port) : host_(host), port_(port),
+                                                                ownedIoService_(new boost::asio::io_service()),
+                                                                io_service_(*ownedIoService_), strand_(io_service_),
+                                                                socket_(io_service_), recvBuffer_(INITIAL_RECV_BUFFER_SIZE),
+                                                                recvStart_(0), recvEnd_(0),
+                                                                sendBatchSize_(DEFAULT_SEND_BATCH_SIZE),
+                                                                readDelimiter_('\0'), readIndex_(), onFrame_(),
+                                                                onClosed_(), closeRequested_(false), sendQueue_(), sendsInFlight_(0),
+                                                                writeBuffers_(), self_() {}
+
+ConnectionHandler::ConnectionHandler(boost::asio::io_service &ioService, string host, short port)
+		: host_(host), port_(port), ownedIoService_(), io_service_(ioService), strand_(io_service_),
+		  socket_(io_service_), recvBuffer_(INITIAL_RECV_BUFFER_SIZE), recvStart_(0), recvEnd_(0),
+		  sendBatchSize_(DEFAULT_SEND_BATCH_SIZE), readDelimiter_('\0'), readIndex_(), onFrame_(),
+		  onClosed_(), closeRequested_(false), sendQueue_(), sendsInFlight_(0), writeBuffers_(), self_() {}
+
+std::shared_ptr<ConnectionHandler> ConnectionHandler::create(boost::asio::io_service &ioService, string host, short port) {
+	std::shared_ptr<ConnectionHandler> handler(new ConnectionHandler(ioService, host, port));
+	handler->self_ = handler;
+	return handler;
+}
+
+std::shared_ptr<ConnectionHandler> ConnectionHandler::lockSelf() const {
+	return std::shared_ptr<ConnectionHandler>(self_);
+}
 
 ConnectionHandler::~ConnectionHandler() {
 	close();
@@ -33,7 +59,10 @@ bool ConnectionHandler::connect() {
 }
 
 bool ConnectionHandler::getBytes(char bytes[], unsigned int bytesToRead) {
-	size_t tmp = 0;
+	// Serve whatever is already buffered before touching the socket
+	size_t tmp = std::min(static_cast<size_t>(bytesToRead), recvEnd_ - recvStart_);
+	std::memcpy(bytes, recvBuffer_.data() + recvStart_, tmp);
+	recvStart_ += tmp;
 	boost::system::error_code error;
 	try {
 		while (!error && bytesToRead > tmp) {
@@ -48,6 +77,39 @@ bool ConnectionHandler::getBytes(char bytes[], unsigned int bytesToRead) {
 	return true;
 }
 
+void ConnectionHandler::prepareBuffer() {
+	bool full = recvEnd_ == recvBuffer_.size();
+	if (recvStart_ == recvEnd_) {
+		recvStart_ = recvEnd_ = 0;
+	} else if (full && recvStart_ != 0) {
+		// Slide the partial frame to the front to make room for the next read
+		std::memmove(recvBuffer_.data(), recvBuffer_.data() + recvStart_, recvEnd_ - recvStart_);
+		readIndex_.shift(recvStart_);
+		recvEnd_ -= recvStart_;
+		recvStart_ = 0;
+	}
+	// Grow while reads keep filling the buffer, up to RECV_BUFFER_SIZE, so an idle connection
+	// stays small. A single frame filling the whole buffer grows it regardless, so the frame
+	// stays contiguous.
+	if (full && (recvBuffer_.size() < RECV_BUFFER_SIZE || recvEnd_ == recvBuffer_.size()))
+		recvBuffer_.resize(recvBuffer_.size() * 2);
+}
+
+bool ConnectionHandler::fillBuffer() {
+	prepareBuffer();
+	boost::system::error_code error;
+	try {
+		recvEnd_ += socket_.read_some(boost::asio::buffer(recvBuffer_.data() + recvEnd_,
+		                                                   recvBuffer_.size() - recvEnd_), error);
+		if (error)
+			throw boost::system::system_error(error);
+	} catch (std::exception &e) {
+		std::cerr << "recv failed (Error: " << e.what() << ')' << std::endl;
+		return false;
+	}
+	return true;
+}
+
 bool ConnectionHandler::sendBytes(const char bytes[], int bytesToWrite) {
 	int tmp = 0;
 	boost::system::error_code error;
@@ -73,18 +135,46 @@ bool ConnectionHandler::sendLine(std::string &line) {
 }
 
 
-bool ConnectionHandler::getFrameAscii(std::string &frame, char delimiter) {
-	char ch;
-	// Stop when we encounter the null character.
+// Append raw bytes to a frame, dropping null characters like the byte-by-byte reader did.
+// With a null delimiter the range cannot contain one, so it is appended in one go.
+static void appendFrameBytes(std::string &frame, const char *begin, const char *end, char delimiter) {
+	if (delimiter == '\0') {
+		frame.append(begin, end);
+		return;
+	}
+	while (begin < end) {
+		const char *nul = static_cast<const char *>(std::memchr(begin, '\0', end - begin));
+		if (nul == nullptr) {
+			frame.append(begin, end);
+			return;
+		}
+		frame.append(begin, nul);
+		begin = nul + 1;
+	}
+}
+
+bool ConnectionHandler::takeBufferedFrame(std::string &frame, char delimiter) {
+	const char *begin = recvBuffer_.data() + recvStart_;
+	const char *end = static_cast<const char *>(std::memchr(begin, delimiter, recvEnd_ - recvStart_));
+	if (end == nullptr)
+		return false;
 	// Notice that the null character is not appended to the frame string.
+	appendFrameBytes(frame, begin, delimiter != '\0' ? end + 1 : end, delimiter);
+	recvStart_ += end + 1 - begin;
+	return true;
+}
+
+bool ConnectionHandler::getFrameAscii(std::string &frame, char delimiter) {
+	// Stop when we encounter the delimiter, reading from the socket a buffer at a time.
 	try {
-		do {
-			if (!getBytes(&ch, 1)) {
+		while (!takeBufferedFrame(frame, delimiter)) {
+			// No delimiter yet - keep the partial frame and read more
+			appendFrameBytes(frame, recvBuffer_.data() + recvStart_, recvBuffer_.data() + recvEnd_, delimiter);
+			recvStart_ = recvEnd_;
+			if (!fillBuffer()) {
 				return false;
 			}
-			if (ch != '\0')
-				frame.append(1, ch);
-		} while (delimiter != ch);
+		}
 	} catch (std::exception &e) {
 		std::cerr << "recv failed2 (Error: " << e.what() << ')' << std::endl;
 		return false;
@@ -98,6 +188,14 @@ bool ConnectionHandler::sendFrameAscii(const std::string &frame, char delimiter)
 	return sendBytes(&delimiter, 1);
 }
 
+void ConnectionHandler::setSendBatchSize(size_t frames) {
+	sendBatchSize_ = std::max(frames, static_cast<size_t>(1));
+}
+
+size_t ConnectionHandler::getSendBatchSize() const {
+	return sendBatchSize_;
+}
+
 // Close down the connection properly.
 void ConnectionHandler::close() {
 	try {
@@ -106,3 +204,157 @@ void ConnectionHandler::close() {
 		std::cout << "closing failed: connection already closed" << std::endl;
 	}
 }
+
+void ConnectionHandler::startReading(char delimiter, FrameHandler onFrame, CloseHandler onClosed) {
+	std::shared_ptr<ConnectionHandler> self = lockSelf();
+	strand_.dispatch([self, delimiter, onFrame, onClosed]() {
+		self->readDelimiter_ = delimiter;
+		// Index what a blocking read already buffered, those frames come first
+		self->readIndex_.clear();
+		self->readIndex_.scan(self->recvBuffer_.data() + self->recvStart_, self->recvEnd_ - self->recvStart_,
+		                      delimiter, static_cast<uint32_t>(self->recvStart_));
+		self->onFrame_ = onFrame;
+		self->onClosed_ = onClosed;
+		self->handleRead(boost::system::error_code(), 0);
+	});
+}
+
+void ConnectionHandler::readSome() {
+	prepareBuffer();
+	std::shared_ptr<ConnectionHandler> self = lockSelf();
+	socket_.async_read_some(boost::asio::buffer(recvBuffer_.data() + recvEnd_, recvBuffer_.size() - recvEnd_),
+	                        strand_.wrap([self](const boost::system::error_code &error, size_t bytesRead) {
+		                        self->handleRead(error, bytesRead);
+	                        }));
+}
+
+void ConnectionHandler::handleRead(const boost::system::error_code &error, size_t bytesRead) {
+	if (error) {
+		CloseHandler onClosed;
+		onClosed.swap(onClosed_);
+		onFrame_ = FrameHandler();
+		if (onClosed)
+			onClosed(closeRequested_ ? boost::asio::error::operation_aborted : error);
+		return;
+	}
+	// One pass over the new bytes marks every delimiter, newline and colon in them
+	readIndex_.scan(recvBuffer_.data() + recvEnd_, bytesRead, readDelimiter_, static_cast<uint32_t>(recvEnd_));
+	recvEnd_ += bytesRead;
+
+	// Split at the delimiter marks, each frame is parsed from the marks before its delimiter
+	FrameView frame;
+	size_t frameMark = 0;
+	for (size_t mark = 0; mark < readIndex_.size(); ++mark) {
+		size_t delimiterAt = readIndex_[mark];
+		if (recvBuffer_[delimiterAt] != readDelimiter_)
+			continue;
+		const char *begin = recvBuffer_.data() + recvStart_;
+		StompFrameParser::parse(begin, delimiterAt - recvStart_, readIndex_.data() + frameMark, mark - frameMark,
+		                        static_cast<uint32_t>(recvStart_), frame);
+		recvStart_ = delimiterAt + 1;
+		frameMark = mark + 1;
+		onFrame_(frame);
+		// The frame handler may have closed the connection
+		if (!socket_.is_open()) {
+			handleRead(boost::asio::error::operation_aborted, 0);
+			return;
+		}
+	}
+	// Keep only the marks of the partial frame
+	readIndex_.dropFront(frameMark);
+	readSome();
+}
+
+void ConnectionHandler::asyncSendFrame(std::string frame, SendHandler onSent) {
+	std::vector<std::string> frames(1);
+	frames[0].swap(frame);
+	asyncSendFrames(std::move(frames), std::move(onSent));
+}
+
+void ConnectionHandler::asyncSendFrames(std::vector<std::string> frames, SendHandler onSent) {
+	std::shared_ptr<ConnectionHandler> self = lockSelf();
+	// Moved into the queue on the strand, the lambda only holds them until then
+	std::shared_ptr<PendingSend> send(new PendingSend());
+	send->frames.swap(frames);
+	send->onSent.swap(onSent);
+	strand_.post([self, send]() {
+		self->sendQueue_.push_back(PendingSend());
+		self->sendQueue_.back().frames.swap(send->frames);
+		self->sendQueue_.back().onSent.swap(send->onSent);
+		if (self->sendsInFlight_ == 0)
+			self->writeQueued();
+	});
+}
+
+void ConnectionHandler::asyncSendBytes(const char *bytes, size_t size, SendHandler onSent) {
+	std::shared_ptr<ConnectionHandler> self = lockSelf();
+	std::shared_ptr<PendingSend> send(new PendingSend());
+	send->bytes = boost::asio::buffer(bytes, size);
+	send->onSent.swap(onSent);
+	strand_.post([self, send]() {
+		self->sendQueue_.push_back(PendingSend());
+		self->sendQueue_.back().bytes = send->bytes;
+		self->sendQueue_.back().onSent.swap(send->onSent);
+		if (self->sendsInFlight_ == 0)
+			self->writeQueued();
+	});
+}
+
+void ConnectionHandler::writeQueued() {
+	writeBuffers_.clear();
+	size_t frames = 0;
+	// Whole queue entries, at least one, until the batch is full
+	while (sendsInFlight_ < sendQueue_.size() && (frames == 0 || frames < sendBatchSize_)) {
+		const PendingSend &send = sendQueue_[sendsInFlight_];
+		for (const std::string &frame : send.frames) {
+			// The string's own terminator doubles as the delimiter
+			writeBuffers_.push_back(boost::asio::buffer(frame.c_str(), frame.length() + 1));
+		}
+		bool borrowed = boost::asio::buffer_size(send.bytes) != 0;
+		if (borrowed) {
+			writeBuffers_.push_back(send.bytes);
+		}
+		frames += borrowed ? 1 : send.frames.size();
+		++sendsInFlight_;
+	}
+	std::shared_ptr<ConnectionHandler> self = lockSelf();
+	boost::asio::async_write(socket_, writeBuffers_,
+	                         strand_.wrap([self](const boost::system::error_code &error, size_t) {
+		                         self->handleWrite(error);
+	                         }));
+}
+
+void ConnectionHandler::handleWrite(const boost::system::error_code &error) {
+	if (error && error != boost::asio::error::operation_aborted)
+		std::cerr << "send failed (Error: " << error.message() << ')' << std::endl;
+	for (; sendsInFlight_ > 0; --sendsInFlight_) {
+		SendHandler onSent;
+		onSent.swap(sendQueue_.front().onSent);
+		sendQueue_.pop_front();
+		if (onSent)
+			onSent(!error);
+	}
+	if (error) {
+		// Fail everything still queued, the connection is unusable
+		while (!sendQueue_.empty()) {
+			SendHandler onSent;
+			onSent.swap(sendQueue_.front().onSent);
+			sendQueue_.pop_front();
+			if (onSent)
+				onSent(false);
+		}
+		return;
+	}
+	if (!sendQueue_.empty())
+		writeQueued();
+}
+
+void ConnectionHandler::asyncClose() {
+	std::shared_ptr<ConnectionHandler> self = lockSelf();
+	// Runs at once when called from one of this connection's handlers
+	strand_.dispatch([self]() {
+		self->closeRequested_ = true;
+		boost::system::error_code ignored;
+		self->socket_.close(ignored);
+	});
+}
@@ -0,0 +1,449 @@
+#include "../include/EventJournal.h"
+#include "../include/MappedFile.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static const char MAGIC[] = {'E', 'M', 'I', 'J', 'R', 'N', 'L', '2'};
+static const size_t MAGIC_SIZE = sizeof(MAGIC);
+
+// The magic and the offset of the first record
+static const size_t HEADER_SIZE = MAGIC_SIZE + sizeof(uint64_t);
+
+// Payload length and checksum
+static const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+// Date time, flags and the channel, user, city, name and description lengths
+static const size_t FIXED_PAYLOAD_SIZE = sizeof(int32_t) + 1 + 5 * sizeof(uint32_t);
+
+// Flag bit of a user's removal, above every GeneralInformationFlag
+static const unsigned char CLEAR_USER_FLAG = 1 << 7;
+
+// FNV-1a over 8 byte words rather than bytes, so replay is not held up checking a million records.
+// Only meant to catch torn writes.
+static uint32_t checksum(const char* data, size_t size) {
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    hash = (hash ^ tail) * prime;
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+static uint32_t readUint32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static char* writeUint32(char* p, uint32_t value) {
+    std::memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+static char* writeBytes(char* p, const char* data, size_t size) {
+    std::memcpy(p, data, size);
+    return p + size;
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool writeHeader(int fd, uint64_t firstOffset) {
+    char header[HEADER_SIZE];
+    std::memcpy(header, MAGIC, MAGIC_SIZE);
+    std::memcpy(header + MAGIC_SIZE, &firstOffset, sizeof(firstOffset));
+    return writeAll(fd, header, HEADER_SIZE);
+}
+
+JournalRecord::JournalRecord() : channel(), user(), city(), name(), description(), dateTime(0), generalFlags(0),
+                                 clearsUser(false) {}
+
+EventJournal::EventJournal()
+    : fd(-1), policy(NO_SYNC), path_(), pendingLock(), wake(), written(), pending(), appendedBytes(0),
+      committedBytes(0), openedLength(0), firstOffset(HEADER_SIZE), flushRequested(false), committing(false),
+      stopping(false), failed(false), committer() {}
+
+EventJournal::~EventJournal() {
+    close();
+}
+
+bool EventJournal::readFirstOffset(const char* data, size_t size, uint64_t& first) {
+    first = HEADER_SIZE;
+    if (size < HEADER_SIZE) {
+        // Empty, or torn while the header was written
+        return size == 0 || std::memcmp(data, MAGIC, std::min(size, MAGIC_SIZE)) == 0;
+    }
+    if (std::memcmp(data, MAGIC, MAGIC_SIZE) != 0) {
+        return false;
+    }
+    std::memcpy(&first, data + MAGIC_SIZE, sizeof(first));
+    return first >= HEADER_SIZE;
+}
+
+void EventJournal::replay(const char* data, size_t size, uint64_t first, uint64_t skipBytes,
+                          const RecordVisitor& visit, size_t& validLength, size_t& records) {
+    records = 0;
+    validLength = 0;
+    if (size < HEADER_SIZE) {
+        return;
+    }
+
+    // A record's offset is first plus how far into the file it is past the header
+    size_t offset = HEADER_SIZE;
+    while (size - offset >= RECORD_HEADER_SIZE) {
+        const char* header = data + offset;
+        size_t length = readUint32(header);
+        const char* payload = header + RECORD_HEADER_SIZE;
+        if (length < FIXED_PAYLOAD_SIZE || length > size - offset - RECORD_HEADER_SIZE ||
+            checksum(payload, length) != readUint32(header + sizeof(uint32_t))) {
+            break;
+        }
+
+        JournalRecord record;
+        int32_t dateTime;
+        std::memcpy(&dateTime, payload, sizeof(dateTime));
+        record.dateTime = dateTime;
+        unsigned char flags = static_cast<unsigned char>(payload[sizeof(int32_t)]);
+        record.clearsUser = (flags & CLEAR_USER_FLAG) != 0;
+        record.generalFlags = flags & ~CLEAR_USER_FLAG;
+        const char* lengths = payload + sizeof(int32_t) + 1;
+        StringSlice* fields[] = {&record.channel, &record.user, &record.city, &record.name, &record.description};
+        const char* text = payload + FIXED_PAYLOAD_SIZE;
+        size_t remaining = length - FIXED_PAYLOAD_SIZE;
+        bool fits = true;
+        for (size_t i = 0; i < 5; ++i) {
+            size_t fieldLength = readUint32(lengths + i * sizeof(uint32_t));
+            if (fieldLength > remaining) {
+                fits = false;
+                break;
+            }
+            *fields[i] = StringSlice(text, fieldLength);
+            text += fieldLength;
+            remaining -= fieldLength;
+        }
+        if (!fits || remaining != 0) {
+            break;
+        }
+
+        if (first + (offset - HEADER_SIZE) >= skipBytes) {
+            visit(record);
+            ++records;
+        }
+        offset += RECORD_HEADER_SIZE + length;
+    }
+    validLength = offset;
+}
+
+bool EventJournal::open(const std::string& path, SyncPolicy syncPolicy, const RecordVisitor& visit,
+                        size_t* replayed, uint64_t skipBytes) {
+    close();
+    if (path == "-") {
+        std::cerr << "The journal must be a file" << std::endl;
+        return false;
+    }
+
+    size_t validLength = 0;
+    size_t records = 0;
+    size_t fileSize = 0;
+    uint64_t first = HEADER_SIZE;
+    {
+        MappedFile existing;
+        if (!existing.open(path)) {
+            if (errno != ENOENT) {
+                std::cerr << "Could not read journal " << path << " (Error: " << std::strerror(errno) << ')'
+                          << std::endl;
+                return false;
+            }
+        } else {
+            fileSize = existing.size();
+            if (!readFirstOffset(existing.data(), fileSize, first)) {
+                std::cerr << "Not an event journal: " << path << std::endl;
+                return false;
+            }
+            if (std::max<uint64_t>(skipBytes, HEADER_SIZE) < first) {
+                std::cerr << "Journal " << path << " starts at offset " << first << " but the snapshot only covers "
+                          << skipBytes << " bytes, the events in between are lost" << std::endl;
+                return false;
+            }
+            replay(existing.data(), fileSize, first, skipBytes, visit, validLength, records);
+        }
+    }
+
+    // Without a whole header, or ending before what the snapshot covers, the journal starts
+    // afresh after the snapshot, so the next restart from it replays every new record
+    uint64_t end = validLength >= HEADER_SIZE ? first + (validLength - HEADER_SIZE) : 0;
+    bool restart = validLength < HEADER_SIZE || end < skipBytes;
+    if (restart && validLength >= HEADER_SIZE) {
+        std::cerr << "Journal " << path << " ends at offset " << end << ", before the " << skipBytes
+                  << " bytes the snapshot covers, starting it afresh after the snapshot" << std::endl;
+    }
+
+    int file = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (file < 0) {
+        std::cerr << "Could not open journal " << path << " (Error: " << std::strerror(errno) << ')' << std::endl;
+        return false;
+    }
+    bool ok;
+    if (restart) {
+        first = std::max<uint64_t>(skipBytes, HEADER_SIZE);
+        end = first;
+        ok = ftruncate(file, 0) == 0 && writeHeader(file, first);
+    } else {
+        // Cut a torn tail, new records go straight after the last good one
+        ok = (validLength == fileSize || ftruncate(file, validLength) == 0) &&
+             lseek(file, validLength, SEEK_SET) >= 0;
+    }
+    if (!ok) {
+        std::cerr << "Could not prepare journal " << path << " (Error: " << std::strerror(errno) << ')' << std::endl;
+        ::close(file);
+        return false;
+    }
+
+    fd = file;
+    policy = syncPolicy;
+    path_ = path;
+    failed = false;
+    stopping = false;
+    flushRequested = false;
+    appendedBytes = 0;
+    committedBytes = 0;
+    committing = false;
+    firstOffset = first;
+    openedLength = end;
+    committer = std::thread(&EventJournal::commitLoop, this);
+    if (replayed) {
+        *replayed = records;
+    }
+    return true;
+}
+
+void EventJournal::close() {
+    if (fd < 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pendingLock);
+        stopping = true;
+    }
+    wake.notify_one();
+    committer.join(); // Writes out whatever is still pending first
+    ::close(fd);
+    fd = -1;
+    path_.clear();
+}
+
+bool EventJournal::isOpen() const {
+    return fd >= 0;
+}
+
+uint64_t EventJournal::size() {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    return openedLength + appendedBytes;
+}
+
+const std::string& EventJournal::path() const {
+    return path_;
+}
+
+void EventJournal::append(const std::string& channel, const std::string& user, const std::string& city,
+                          const std::string& name, int dateTime, unsigned char generalFlags,
+                          const char* description, size_t descriptionLength) {
+    appendRecord(channel, user, city, name, dateTime, generalFlags & ~CLEAR_USER_FLAG, description,
+                 descriptionLength);
+}
+
+void EventJournal::appendClearUser(const std::string& user) {
+    std::string none;
+    appendRecord(none, user, none, none, 0, CLEAR_USER_FLAG, none.data(), 0);
+}
+
+void EventJournal::appendRecord(const std::string& channel, const std::string& user, const std::string& city,
+                                const std::string& name, int dateTime, unsigned char flags,
+                                const char* description, size_t descriptionLength) {
+    size_t length = FIXED_PAYLOAD_SIZE + channel.size() + user.size() + city.size() + name.size() +
+                    descriptionLength;
+    size_t recordSize = RECORD_HEADER_SIZE + length;
+
+    std::unique_lock<std::mutex> lock(pendingLock);
+    // Back-pressure: one batch is being written while the next fills, so at most about twice
+    // MAX_PENDING_BYTES is ever held. A record bigger than that still goes into an empty buffer.
+    while (fd >= 0 && !failed && !stopping && !pending.empty() &&
+           pending.size() + recordSize > MAX_PENDING_BYTES) {
+        wake.notify_one();
+        written.wait(lock);
+    }
+    if (fd < 0 || failed) {
+        return;
+    }
+    size_t start = pending.size();
+    pending.resize(start + recordSize);
+    char* payload = &pending[start] + RECORD_HEADER_SIZE;
+
+    int32_t time = dateTime;
+    char* p = writeBytes(payload, reinterpret_cast<const char*>(&time), sizeof(time));
+    *p++ = static_cast<char>(flags);
+    p = writeUint32(p, static_cast<uint32_t>(channel.size()));
+    p = writeUint32(p, static_cast<uint32_t>(user.size()));
+    p = writeUint32(p, static_cast<uint32_t>(city.size()));
+    p = writeUint32(p, static_cast<uint32_t>(name.size()));
+    p = writeUint32(p, static_cast<uint32_t>(descriptionLength));
+    p = writeBytes(p, channel.data(), channel.size());
+    p = writeBytes(p, user.data(), user.size());
+    p = writeBytes(p, city.data(), city.size());
+    p = writeBytes(p, name.data(), name.size());
+    writeBytes(p, description, descriptionLength);
+
+    char* header = &pending[start];
+    header = writeUint32(header, static_cast<uint32_t>(length));
+    writeUint32(header, checksum(payload, length));
+
+    appendedBytes += recordSize;
+    bool full = pending.size() >= GROUP_COMMIT_BYTES;
+    lock.unlock();
+    if (full) {
+        wake.notify_one();
+    }
+}
+
+bool EventJournal::flush() {
+    std::unique_lock<std::mutex> lock(pendingLock);
+    if (fd < 0) {
+        return !failed;
+    }
+    uint64_t target = appendedBytes;
+    flushRequested = true;
+    wake.notify_one();
+    written.wait(lock, [this, target] { return committedBytes >= target; });
+    if (failed || policy == SYNC_EACH_COMMIT) {
+        return !failed; // Synced by the committer
+    }
+    // Only rollOver() swaps the file, and it takes the lock too
+    int file = fd;
+    lock.unlock();
+    if (fdatasync(file) != 0) {
+        std::cerr << "Journal sync failed (Error: " << std::strerror(errno) << ')' << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool EventJournal::rollOver(uint64_t covered) {
+    std::unique_lock<std::mutex> lock(pendingLock);
+    if (fd < 0 || failed) {
+        return false;
+    }
+    // A batch being written would land in the old file, so wait it out. Holding the lock from
+    // here on keeps the committer and the appenders away until the new file is in place.
+    written.wait(lock, [this] { return !committing; });
+    uint64_t end = openedLength + committedBytes;
+    if (covered <= firstOffset || covered > end) {
+        return covered == firstOffset; // Nothing to drop, or offsets this journal never reached
+    }
+
+    // The records after covered are what came in while the snapshot was written, usually little
+    std::vector<char> tail(end - covered);
+    off_t from = static_cast<off_t>(covered - firstOffset + HEADER_SIZE);
+    size_t read = 0;
+    while (read < tail.size()) {
+        ssize_t n = pread(fd, tail.data() + read, tail.size() - read, from + read);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Could not read journal " << path_ << " to roll it over (Error: " << std::strerror(errno)
+                      << ')' << std::endl;
+            return false;
+        }
+        read += n;
+    }
+
+    std::string temporary = path_ + ".tmp";
+    int file = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = file >= 0 && writeHeader(file, covered) && writeAll(file, tail.data(), tail.size()) &&
+              fdatasync(file) == 0 && std::rename(temporary.c_str(), path_.c_str()) == 0;
+    if (!ok) {
+        std::cerr << "Could not roll journal " << path_ << " over (Error: " << std::strerror(errno) << ')'
+                  << std::endl;
+        if (file >= 0) {
+            ::close(file);
+        }
+        ::unlink(temporary.c_str());
+        return false;
+    }
+    ::close(fd);
+    fd = file; // Positioned after the tail, where the next batch goes
+    firstOffset = covered;
+    if (!syncParentDirectory(path_)) {
+        std::cerr << "Could not sync the directory of journal " << path_ << " (Error: " << std::strerror(errno)
+                  << ')' << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void EventJournal::commitLoop() {
+    std::vector<char> writing;
+    std::unique_lock<std::mutex> lock(pendingLock);
+    while (true) {
+        // Also wakes on the interval, so a trickle of events is written within COMMIT_INTERVAL_MS
+        wake.wait_for(lock, std::chrono::milliseconds(COMMIT_INTERVAL_MS),
+                      [this] { return stopping || flushRequested || pending.size() >= GROUP_COMMIT_BYTES; });
+        flushRequested = false;
+        if (pending.empty()) {
+            if (stopping) {
+                return;
+            }
+            written.notify_all();
+            continue;
+        }
+
+        // Take the whole batch, appends carry on into the other buffer during the write
+        writing.swap(pending);
+        uint64_t batchEnd = appendedBytes;
+        bool ok = !failed;
+        int file = fd;
+        committing = true;
+        lock.unlock();
+
+        if (ok) {
+            ok = writeAll(file, writing.data(), writing.size()) &&
+                 (policy != SYNC_EACH_COMMIT || fdatasync(file) == 0);
+            if (!ok) {
+                std::cerr << "Journal write failed (Error: " << std::strerror(errno) << ')' << std::endl;
+            }
+        }
+        writing.clear();
+
+        lock.lock();
+        failed = failed || !ok;
+        committedBytes = batchEnd;
+        committing = false;
+        written.notify_all();
+    }
+}
@@ -0,0 +1,175 @@
+#include "../include/EventSorter.h"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+// A spilled event: date time, then city, name and description, then the general information
+// entries, each string a uint32 length and its bytes, in host byte order
+
+static void writeUint32(FILE* file, uint32_t value) {
+    std::fwrite(&value, sizeof(value), 1, file);
+}
+
+static void writeString(FILE* file, const std::string& value) {
+    writeUint32(file, static_cast<uint32_t>(value.size()));
+    std::fwrite(value.data(), 1, value.size(), file);
+}
+
+static void writeEvent(FILE* file, const Event& event) {
+    int32_t dateTime = event.get_date_time();
+    std::fwrite(&dateTime, sizeof(dateTime), 1, file);
+    writeString(file, event.get_city());
+    writeString(file, event.get_name());
+    writeString(file, event.get_description());
+    uint32_t entries = 0;
+    event.for_each_general_information([&entries](const std::string&, const std::string&) { ++entries; });
+    writeUint32(file, entries);
+    event.for_each_general_information([file](const std::string& key, const std::string& value) {
+        writeString(file, key);
+        writeString(file, value);
+    });
+}
+
+static void readExactly(FILE* file, void* data, size_t size) {
+    if (size > 0 && std::fread(data, 1, size, file) != size) {
+        throw std::runtime_error("Could not read back a sorted run of events");
+    }
+}
+
+static uint32_t readUint32(FILE* file) {
+    uint32_t value;
+    readExactly(file, &value, sizeof(value));
+    return value;
+}
+
+static std::string readString(FILE* file) {
+    std::string value(readUint32(file), '\0');
+    readExactly(file, &value[0], value.size());
+    return value;
+}
+
+// The next event of a spilled run, null once the run is used up
+static std::unique_ptr<Event> readEvent(FILE* file, const std::string& channel) {
+    int32_t dateTime;
+    if (std::fread(&dateTime, sizeof(dateTime), 1, file) != 1) {
+        if (std::ferror(file)) {
+            throw std::runtime_error("Could not read back a sorted run of events");
+        }
+        return std::unique_ptr<Event>();
+    }
+    std::string city = readString(file);
+    std::string name = readString(file);
+    std::string description = readString(file);
+    std::map<std::string, std::string> generalInformation;
+    for (uint32_t entries = readUint32(file); entries > 0; --entries) {
+        std::string key = readString(file);
+        generalInformation[key] = readString(file);
+    }
+    return std::unique_ptr<Event>(new Event(channel, std::move(city), std::move(name), dateTime,
+                                            std::move(description), std::move(generalInformation)));
+}
+
+static bool earlier(const Event& a, const Event& b) {
+    return a.get_date_time() < b.get_date_time();
+}
+
+EventSorter::EventSorter(size_t runEvents) : runEvents(std::max(runEvents, static_cast<size_t>(1))), run(), spilled() {}
+
+EventSorter::~EventSorter() {
+    for (FILE* file : spilled) {
+        std::fclose(file);
+    }
+}
+
+void EventSorter::add(Event& event) {
+    if (run.size() >= runEvents) {
+        spill();
+    }
+    run.push_back(std::move(event));
+}
+
+void EventSorter::sortRun() {
+    std::stable_sort(run.begin(), run.end(), earlier);
+}
+
+void EventSorter::spill() {
+    sortRun();
+    FILE* file = std::tmpfile(); // Unlinked already, gone when closed
+    if (!file) {
+        throw std::runtime_error("Could not create a temporary file for sorting events");
+    }
+    spilled.push_back(file);
+    for (const Event& event : run) {
+        writeEvent(file, event);
+    }
+    if (std::fflush(file) != 0 || std::ferror(file)) {
+        throw std::runtime_error("Could not write a sorted run of events");
+    }
+    run.clear();
+}
+
+size_t EventSorter::spilledRuns() const {
+    return spilled.size();
+}
+
+bool EventSorter::finish(const std::string& channel, const EventVisitor& visit) {
+    sortRun();
+    if (spilled.empty()) {
+        for (Event& event : run) {
+            if (!visit(event)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Source i < spilled.size() is a spilled run, the last source is the run still in memory.
+    // Ties go to the lower source, which holds the earlier arrivals.
+    struct Head {
+        int dateTime;
+        size_t source;
+    };
+    struct Later {
+        bool operator()(const Head& a, const Head& b) const {
+            return a.dateTime != b.dateTime ? a.dateTime > b.dateTime : a.source > b.source;
+        }
+    };
+    std::priority_queue<Head, std::vector<Head>, Later> heads;
+    std::vector<std::unique_ptr<Event>> next(spilled.size());
+    for (size_t i = 0; i < spilled.size(); ++i) {
+        std::rewind(spilled[i]);
+        next[i] = readEvent(spilled[i], channel);
+        if (next[i]) {
+            heads.push(Head{next[i]->get_date_time(), i});
+        }
+    }
+    size_t inMemory = 0;
+    if (!run.empty()) {
+        heads.push(Head{run[0].get_date_time(), spilled.size()});
+    }
+
+    while (!heads.empty()) {
+        size_t source = heads.top().source;
+        heads.pop();
+        if (source == spilled.size()) {
+            if (!visit(run[inMemory])) {
+                return false;
+            }
+            if (++inMemory < run.size()) {
+                heads.push(Head{run[inMemory].get_date_time(), source});
+            }
+            continue;
+        }
+        if (!visit(*next[source])) {
+            return false;
+        }
+        next[source] = readEvent(spilled[source], channel);
+        if (next[source]) {
+            heads.push(Head{next[source]->get_date_time(), source});
+        }
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+#include "../include/FrameView.h"
+#include "../include/StompFrameParser.h"
+#include <cstring>
+
+StringSlice::StringSlice() : data(nullptr), size(0) {}
+
+StringSlice::StringSlice(const char* data, size_t size) : data(data), size(size) {}
+
+bool StringSlice::empty() const {
+    return size == 0;
+}
+
+bool StringSlice::equals(const char* literal) const {
+    size_t length = std::strlen(literal);
+    return length == size && std::memcmp(data, literal, size) == 0;
+}
+
+bool StringSlice::startsWith(const char* prefix) const {
+    size_t length = std::strlen(prefix);
+    return length <= size && std::memcmp(data, prefix, length) == 0;
+}
+
+StringSlice StringSlice::dropPrefix(size_t count) const {
+    if (count >= size) {
+        return StringSlice(data + size, 0);
+    }
+    return StringSlice(data + count, size - count);
+}
+
+StringSlice StringSlice::trim() const {
+    StringSlice result(*this);
+    while (result.size > 0 && (result.data[0] == ' ' || result.data[0] == '\t')) {
+        ++result.data;
+        --result.size;
+    }
+    while (result.size > 0 && (result.data[result.size - 1] == ' ' || result.data[result.size - 1] == '\t')) {
+        --result.size;
+    }
+    return result;
+}
+
+bool StringSlice::toInt(int& value) const {
+    size_t i = 0;
+    while (i < size && (data[i] == ' ' || data[i] == '\t')) {
+        ++i;
+    }
+    bool negative = false;
+    if (i < size && (data[i] == '-' || data[i] == '+')) {
+        negative = data[i] == '-';
+        ++i;
+    }
+    size_t firstDigit = i;
+    long long result = 0;
+    while (i < size && data[i] >= '0' && data[i] <= '9') {
+        result = result * 10 + (data[i] - '0');
+        ++i;
+    }
+    if (i == firstDigit) {
+        return false;
+    }
+    value = static_cast<int>(negative ? -result : result);
+    return true;
+}
+
+std::string StringSlice::str() const {
+    return std::string(data, size);
+}
+
+FrameView::FrameView()
+    : raw(), command(), body(), commandType(StompCommand::UNKNOWN), headerNames(), headerValues(),
+      numHeaders(0), knownHeaders(), knownHeaderMask(0), marks(nullptr), markCount(0), markBase(0), bodyMark(0) {}
+
+void FrameView::clear() {
+    raw = StringSlice();
+    command = StringSlice();
+    body = StringSlice();
+    commandType = StompCommand::UNKNOWN;
+    numHeaders = 0;
+    knownHeaderMask = 0;
+    marks = nullptr;
+    markCount = 0;
+    markBase = 0;
+    bodyMark = 0;
+}
+
+bool FrameView::parse(const char* data, size_t size) {
+    return StompFrameParser::parse(data, size, *this);
+}
+
+StompCommand FrameView::type() const {
+    return commandType;
+}
+
+size_t FrameView::headerCount() const {
+    return numHeaders;
+}
+
+const StringSlice& FrameView::headerName(size_t index) const {
+    return headerNames[index];
+}
+
+const StringSlice& FrameView::headerValue(size_t index) const {
+    return headerValues[index];
+}
+
+bool FrameView::hasHeader(StompHeader header) const {
+    return header != StompHeader::UNKNOWN && (knownHeaderMask & (1u << static_cast<int>(header))) != 0;
+}
+
+const StringSlice& FrameView::header(StompHeader header) const {
+    static const StringSlice missing;
+    return hasHeader(header) ? knownHeaders[static_cast<int>(header)] : missing;
+}
+
+bool FrameView::getHeader(const char* name, StringSlice& value) const {
+    for (size_t i = 0; i < numHeaders; ++i) {
+        if (headerNames[i].equals(name)) {
+            value = headerValues[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+int FrameView::receiptId() const {
+    int id = -1;
+    if (!hasHeader(StompHeader::RECEIPT_ID) || !header(StompHeader::RECEIPT_ID).toInt(id)) {
+        return -1;
+    }
+    return id;
+}
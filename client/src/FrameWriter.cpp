@@ -0,0 +1,108 @@
+#include "../include/FrameWriter.h"
+#include <cstring>
+
+const size_t FrameWriter::DEFAULT_CAPACITY;
+const size_t FrameWriter::MAX_INT_CHARS;
+
+FrameWriter::FrameWriter(size_t capacity) : buffer(), frames(0) {
+    buffer.reserve(capacity);
+}
+
+FrameWriter& FrameWriter::command(const char* name) {
+    append(name);
+    return append('\n');
+}
+
+FrameWriter& FrameWriter::header(const char* name, const std::string& value) {
+    append(name);
+    append(':');
+    append(value);
+    return append('\n');
+}
+
+FrameWriter& FrameWriter::header(const char* name, long value) {
+    append(name);
+    append(':');
+    append(value);
+    return append('\n');
+}
+
+FrameWriter& FrameWriter::append(const std::string& text) {
+    buffer.append(text);
+    return *this;
+}
+
+FrameWriter& FrameWriter::append(const char* data, size_t length) {
+    buffer.append(data, length);
+    return *this;
+}
+
+FrameWriter& FrameWriter::append(const char* text) {
+    return append(text, std::strlen(text));
+}
+
+FrameWriter& FrameWriter::append(char c) {
+    buffer.push_back(c);
+    return *this;
+}
+
+FrameWriter& FrameWriter::append(long value) {
+    char digits[MAX_INT_CHARS];
+    return append(digits, formatInt(digits, value));
+}
+
+FrameWriter& FrameWriter::endHeaders() {
+    return append('\n');
+}
+
+void FrameWriter::endFrame() {
+    buffer.push_back('\0');
+    ++frames;
+}
+
+const char* FrameWriter::data() const {
+    return buffer.data();
+}
+
+size_t FrameWriter::size() const {
+    return buffer.size();
+}
+
+size_t FrameWriter::frameCount() const {
+    return frames;
+}
+
+bool FrameWriter::empty() const {
+    return buffer.empty();
+}
+
+void FrameWriter::clear() {
+    buffer.clear();
+    frames = 0;
+}
+
+std::string FrameWriter::takeFrame() {
+    std::string frame;
+    frame.swap(buffer);
+    frames = 0;
+    return frame;
+}
+
+size_t FrameWriter::formatInt(char* out, long value) {
+    // Digits come out backwards, so fill a scratch buffer from its end
+    char scratch[MAX_INT_CHARS];
+    char* end = scratch + MAX_INT_CHARS;
+    char* digit = end;
+    // Negate through unsigned so the most negative value does not overflow
+    unsigned long magnitude = value < 0 ? 0UL - static_cast<unsigned long>(value) : static_cast<unsigned long>(value);
+    do {
+        *--digit = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+        *--digit = '-';
+    }
+    size_t length = end - digit;
+    std::memcpy(out, digit, length);
+    return length;
+}
@@ -0,0 +1,107 @@
+#include "../include/MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+MappedFile::MappedFile() : data_(nullptr), size_(0), mapping_(nullptr), buffer_() {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    if (path == "-") {
+        return readAll(STDIN_FILENO);
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    bool ok;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            // The parsers read front to back, let the kernel read ahead aggressively
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+            mapping_ = mapping;
+            data_ = static_cast<const char*>(mapping);
+            size_ = info.st_size;
+            ok = true;
+        } else {
+            ok = readAll(fd);
+        }
+    } else {
+        // Pipes, character devices and empty files
+        ok = readAll(fd);
+    }
+
+    ::close(fd);
+    return ok;
+}
+
+bool MappedFile::readAll(int fd) {
+    const size_t chunk = 1 << 16;
+    size_t used = 0;
+    while (true) {
+        buffer_.resize(used + chunk);
+        ssize_t bytes = ::read(fd, buffer_.data() + used, chunk);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            buffer_.clear();
+            return false;
+        }
+        if (bytes == 0) {
+            break;
+        }
+        used += bytes;
+    }
+    buffer_.resize(used);
+    data_ = buffer_.data();
+    size_ = used;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapping_) {
+        munmap(mapping_, size_);
+        mapping_ = nullptr;
+    }
+    buffer_.clear();
+    data_ = nullptr;
+    size_ = 0;
+}
+
+const char* MappedFile::data() const {
+    return data_;
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
+
+bool MappedFile::isMapped() const {
+    return mapping_ != nullptr;
+}
+
+bool syncParentDirectory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    int error = errno;
+    ::close(fd);
+    errno = error;
+    return ok;
+}
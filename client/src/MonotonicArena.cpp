@@ -0,0 +1,55 @@
+#include "../include/MonotonicArena.h"
+#include <cstdint>
+#include <cstring>
+
+MonotonicArena::MonotonicArena(size_t initialChunkSize, size_t maxChunkSize)
+    : chunks(), cursor(nullptr), remaining(0), nextChunkSize(initialChunkSize), maxChunkSize(maxChunkSize),
+      bytesAllocated(0) {}
+
+void MonotonicArena::grow(size_t size) {
+    // Oversized requests get a chunk of their own
+    size_t newChunkSize = size > nextChunkSize ? size : nextChunkSize;
+    if (nextChunkSize < maxChunkSize) {
+        nextChunkSize = nextChunkSize * 2 < maxChunkSize ? nextChunkSize * 2 : maxChunkSize;
+    }
+    chunks.push_back(std::unique_ptr<char[]>(new char[newChunkSize]));
+    cursor = chunks.back().get();
+    remaining = newChunkSize;
+}
+
+void* MonotonicArena::allocate(size_t size, size_t alignment) {
+    size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(cursor) % alignment) % alignment;
+    if (cursor == nullptr || padding + size > remaining) {
+        grow(size + alignment);
+        padding = (alignment - reinterpret_cast<std::uintptr_t>(cursor) % alignment) % alignment;
+    }
+    char* result = cursor + padding;
+    cursor += padding + size;
+    remaining -= padding + size;
+    bytesAllocated += size;
+    return result;
+}
+
+const char* MonotonicArena::copy(const char* data, size_t length) {
+    if (length == 0) {
+        return "";
+    }
+    char* result = static_cast<char*>(allocate(length, 1));
+    std::memcpy(result, data, length);
+    return result;
+}
+
+void MonotonicArena::release() {
+    chunks.clear();
+    cursor = nullptr;
+    remaining = 0;
+    bytesAllocated = 0;
+}
+
+size_t MonotonicArena::getBytesAllocated() const {
+    return bytesAllocated;
+}
+
+size_t MonotonicArena::getChunkCount() const {
+    return chunks.size();
+}
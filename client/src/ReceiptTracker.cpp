@@ -0,0 +1,88 @@
+#include "../include/ReceiptTracker.h"
+#include <thread>
+
+const size_t ReceiptTracker::DEFAULT_CAPACITY;
+
+ReceiptTracker::Slot::Slot() : state(EMPTY), id(-1), message(), sentAt() {}
+
+ReceiptTracker::ReceiptTracker(size_t capacity) : slots(), mask(0) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+}
+
+int ReceiptTracker::claim(Slot& slot, int transient, bool fromEmpty) const {
+    while (true) {
+        int current = slot.state.load(std::memory_order_acquire);
+        if (current == WRITING || current == TAKING) {
+            // Another thread is mid-update, it finishes in a few instructions
+            std::this_thread::yield();
+            continue;
+        }
+        if (current == EMPTY && !fromEmpty) {
+            return EMPTY;
+        }
+        if (slot.state.compare_exchange_weak(current, transient, std::memory_order_acquire)) {
+            return current;
+        }
+    }
+}
+
+bool ReceiptTracker::registerReceipt(int id, const std::string& message) {
+    Slot& slot = slots[static_cast<size_t>(id) & mask];
+    int previous = claim(slot, WRITING, true);
+
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.message = message;
+    slot.sentAt = std::chrono::steady_clock::now();
+    slot.state.store(READY, std::memory_order_release);
+    return previous == EMPTY;
+}
+
+bool ReceiptTracker::take(int id, std::string& message, std::chrono::microseconds& roundTrip) {
+    Slot& slot = slots[static_cast<size_t>(id) & mask];
+    if (slot.id.load(std::memory_order_relaxed) != id || claim(slot, TAKING, false) == EMPTY) {
+        return false;
+    }
+    // The slot may have been reused for another id before we claimed it
+    if (slot.id.load(std::memory_order_relaxed) != id) {
+        slot.state.store(READY, std::memory_order_release);
+        return false;
+    }
+
+    message = std::move(slot.message);
+    slot.message.clear();
+    roundTrip = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - slot.sentAt);
+    slot.id.store(-1, std::memory_order_relaxed);
+    slot.state.store(EMPTY, std::memory_order_release);
+    return true;
+}
+
+bool ReceiptTracker::take(int id, std::string& message) {
+    std::chrono::microseconds roundTrip;
+    return take(id, message, roundTrip);
+}
+
+bool ReceiptTracker::contains(int id) const {
+    const Slot& slot = slots[static_cast<size_t>(id) & mask];
+    return slot.state.load(std::memory_order_acquire) != EMPTY && slot.id.load(std::memory_order_relaxed) == id;
+}
+
+void ReceiptTracker::clear() {
+    for (size_t i = 0; i <= mask; ++i) {
+        Slot& slot = slots[i];
+        if (claim(slot, TAKING, false) == EMPTY) {
+            continue;
+        }
+        slot.message.clear();
+        slot.id.store(-1, std::memory_order_relaxed);
+        slot.state.store(EMPTY, std::memory_order_release);
+    }
+}
+
+size_t ReceiptTracker::capacity() const {
+    return mask + 1;
+}
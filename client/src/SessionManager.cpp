@@ -0,0 +1,267 @@
+#include "../include/SessionManager.h"
+#include "../include/StompFrameParser.h"
+#include <algorithm>
+#include <future>
+
+Session::Session(boost::asio::io_service& ioService, std::ostream* output, size_t receiptCapacity)
+    : ioService(ioService),
+      output(output),
+      protocol(receiptCapacity),
+      connection(),
+      userLock(),
+      user(),
+      connected(false),
+      keepEvents(true),
+      onReceipt(),
+      onFrame(),
+      self()
+{}
+
+std::shared_ptr<Session> Session::create(boost::asio::io_service& ioService, std::ostream* output, size_t receiptCapacity) {
+    std::shared_ptr<Session> session = std::make_shared<Session>(ioService, output, receiptCapacity);
+    session->self = session;
+    return session;
+}
+
+bool Session::connect(const std::string& host, short port) {
+    std::shared_ptr<ConnectionHandler> previous = std::atomic_load(&connection);
+    if (previous) {
+        previous->asyncClose();
+    }
+    std::shared_ptr<ConnectionHandler> handler = ConnectionHandler::create(ioService, host, port);
+    if (!handler->connect()) {
+        return false;
+    }
+    std::atomic_store(&connection, handler);
+    connected = true;
+    startReading();
+    return true;
+}
+
+bool Session::login(const std::string& username, const std::string& password) {
+    // Set before CONNECT goes out, an ERROR in reply resets the session on an io thread
+    {
+        std::lock_guard<std::mutex> lock(userLock);
+        user = username;
+    }
+    return sendAndWait(protocol.constructConnectFrame(username, password));
+}
+
+// Frames arriving on the connection are processed as completion handlers on an io thread
+void Session::startReading() {
+    std::shared_ptr<ConnectionHandler> handler = std::atomic_load(&connection);
+    std::weak_ptr<Session> session = self;
+    handler->startReading('\0',
+        [session](const FrameView& frame) {
+            std::shared_ptr<Session> live = session.lock();
+            if (live) {
+                live->processFrame(frame);
+            }
+        },
+        [session](const boost::system::error_code& error) {
+            std::shared_ptr<Session> live = session.lock();
+            // A close we asked for ends reading with operation_aborted
+            if (live && error != boost::asio::error::operation_aborted) {
+                if (live->output) {
+                    *live->output << "Connection closed by server or error occurred. Disconnecting listener.\n";
+                }
+                live->connected = false;
+            }
+        });
+}
+
+void Session::send(std::vector<std::string> frames, ConnectionHandler::SendHandler onSent) {
+    std::shared_ptr<ConnectionHandler> handler = std::atomic_load(&connection);
+    if (!handler) {
+        if (onSent) {
+            onSent(false);
+        }
+        return;
+    }
+    handler->asyncSendFrames(std::move(frames), std::move(onSent));
+}
+
+void Session::send(std::string frame, ConnectionHandler::SendHandler onSent) {
+    std::vector<std::string> frames(1);
+    frames[0].swap(frame);
+    send(std::move(frames), std::move(onSent));
+}
+
+bool Session::sendAndWait(std::vector<std::string>& frames) {
+    std::shared_ptr<std::promise<bool>> sent = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = sent->get_future();
+    send(std::move(frames), [sent](bool ok) { sent->set_value(ok); });
+    frames.clear();
+    return result.get();
+}
+
+bool Session::sendAndWait(const std::string& frame) {
+    std::vector<std::string> frames(1, frame);
+    return sendAndWait(frames);
+}
+
+bool Session::sendAndWait(const FrameWriter& writer) {
+    std::shared_ptr<ConnectionHandler> handler = std::atomic_load(&connection);
+    if (!handler) {
+        return false;
+    }
+    // Waiting keeps the writer's buffer alive and unchanged for the whole write
+    std::shared_ptr<std::promise<bool>> sent = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = sent->get_future();
+    handler->asyncSendBytes(writer.data(), writer.size(), [sent](bool ok) { sent->set_value(ok); });
+    return result.get();
+}
+
+void Session::reset() {
+    protocol.getSummaryManager().clearClientData(getUser());
+    protocol.receiptTracker.clear();
+    protocol.isLogicConnected.store(false);
+    protocol.sentDisconnect.store(-1);
+    protocol.channelToSubcriptonID.clear();
+    close();
+}
+
+void Session::close() {
+    connected = false;
+    std::shared_ptr<ConnectionHandler> handler = std::atomic_load(&connection);
+    if (handler) {
+        handler->asyncClose();
+    }
+}
+
+// Frames are processed straight from the receive buffer.
+// Nothing is copied until a MESSAGE has to be stored as an Event.
+void Session::processFrame(const FrameView& frame) {
+    if (frame.type() == StompCommand::CONNECTED) {
+        protocol.isLogicConnected.store(true);
+        if (output) {
+            *output << "Login successful!\n";
+        }
+    }
+    else if (frame.type() == StompCommand::MESSAGE && keepEvents) {
+        EventReportView report;
+        StompFrameParser::parseEventReport(frame, report);
+
+        // Create and store the event
+        std::string channel = report.channel.str();
+        Event event(channel, report.city.str(), report.eventName.str(), report.dateTime,
+                    std::move(report.description), std::move(report.generalInformation));
+        protocol.getSummaryManager().addEvent(channel, report.user.str(), std::move(event));
+    }
+    else if (frame.type() == StompCommand::RECEIPT) {
+        int id = frame.receiptId();
+        bool needDisconnect = id != -1 && id == protocol.sentDisconnect.load();
+        // Complete the receipt in one step, printing its message if we were waiting for it
+        std::string message;
+        std::chrono::microseconds roundTrip;
+        if (protocol.receiptTracker.take(id, message, roundTrip)) {
+            if (output) {
+                *output << message << std::endl;
+            }
+            if (onReceipt) {
+                onReceipt(id, roundTrip);
+            }
+        }
+        // Graceful disconnection
+        if (needDisconnect) {
+            reset();
+        }
+    }
+    else if (frame.type() == StompCommand::ERROR) {
+        if (output) {
+            output->write(frame.raw.data, frame.raw.size) << std::endl;
+        }
+        reset();
+    }
+
+    if (onFrame) {
+        onFrame(frame);
+    }
+}
+
+void Session::setReceiptHandler(ReceiptHandler handler) {
+    onReceipt = handler;
+}
+
+void Session::setFrameObserver(FrameObserver observer) {
+    onFrame = observer;
+}
+
+void Session::setKeepEvents(bool keep) {
+    keepEvents = keep;
+}
+
+StompProtocol& Session::getProtocol() {
+    return protocol;
+}
+
+std::string Session::getUser() const {
+    std::lock_guard<std::mutex> lock(userLock);
+    return user;
+}
+
+bool Session::isConnected() const {
+    return connected.load();
+}
+
+bool Session::isLoggedIn() const {
+    return protocol.isLogicConnected.load();
+}
+
+SessionManager::SessionManager(size_t threadCount)
+    : ioService(),
+      keepRunning(new boost::asio::io_service::work(ioService)),
+      ioThreads(),
+      sessionsLock(),
+      sessions()
+{
+    threadCount = std::max(threadCount, static_cast<size_t>(1));
+    for (size_t i = 0; i < threadCount; ++i) {
+        ioThreads.emplace_back([this]() { ioService.run(); });
+    }
+}
+
+SessionManager::~SessionManager() {
+    stop();
+}
+
+std::shared_ptr<Session> SessionManager::createSession(std::ostream* output, size_t receiptCapacity) {
+    std::shared_ptr<Session> session = Session::create(ioService, output, receiptCapacity);
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    sessions.push_back(session);
+    return session;
+}
+
+void SessionManager::removeSession(const std::shared_ptr<Session>& session) {
+    session->close();
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    sessions.erase(std::remove(sessions.begin(), sessions.end(), session), sessions.end());
+}
+
+std::vector<std::shared_ptr<Session>> SessionManager::getSessions() const {
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    return sessions;
+}
+
+size_t SessionManager::sessionCount() const {
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    return sessions.size();
+}
+
+boost::asio::io_service& SessionManager::getIoService() {
+    return ioService;
+}
+
+void SessionManager::stop() {
+    for (const std::shared_ptr<Session>& session : getSessions()) {
+        session->close();
+    }
+    // Let the closes run, then let run() return once nothing is pending
+    keepRunning.reset();
+    for (std::thread& thread : ioThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    ioThreads.clear();
+}
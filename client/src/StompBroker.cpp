@@ -0,0 +1,548 @@
+#include "../include/FrameView.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Local stand-in for the STOMP server, for measuring the client on one machine.
+// Speaks the subset StompProtocol uses (CONNECT/SUBSCRIBE/UNSUBSCRIBE/SEND/DISCONNECT in,
+// CONNECTED/RECEIPT/MESSAGE/ERROR out) with the Java server's frame layout and rules,
+// from a single epoll loop on localhost. Unlike the Java server it acknowledges every
+// frame that asks for a receipt, SEND included, so the client can time round trips.
+//
+// Usage: StompBroker {port} [--latency microseconds] [--fanout N]
+//   --latency  hold every outgoing frame this long before writing it
+//   --fanout   deliver each SEND N times to every subscriber, as if there were N times as many
+
+typedef std::chrono::steady_clock Clock;
+
+struct BrokerOptions {
+    int port;
+    long latencyMicros;
+    int fanout;
+
+    BrokerOptions() : port(0), latencyMicros(0), fanout(1) {}
+};
+
+struct BrokerConnection {
+    int fd;
+    std::vector<char> input;     // Bytes read but not yet framed
+    std::string output;          // Bytes waiting for the socket to accept them
+    std::string user;            // Empty until CONNECT succeeds
+    std::map<std::string, std::string> subscriptions; // Subscription id -> channel
+    bool closing;                // A final frame is queued (DISCONNECT, ERROR), input is ignored
+    bool closeAfterFlush;        // The final frame is in output, close once it is written
+    bool wantsWrite;             // EPOLLOUT is registered
+
+    explicit BrokerConnection(int fd)
+        : fd(fd), input(), output(), user(), subscriptions(), closing(false), closeAfterFlush(false),
+          wantsWrite(false) {}
+};
+
+// A frame held back by the artificial latency
+struct DelayedFrame {
+    Clock::time_point due;
+    int fd;
+    std::string frame;   // Includes the trailing null, empty for a bare close
+    bool closeAfter;
+
+    DelayedFrame(Clock::time_point due, int fd, std::string&& frame, bool closeAfter)
+        : due(due), fd(fd), frame(std::move(frame)), closeAfter(closeAfter) {}
+};
+
+class StompBroker {
+public:
+    explicit StompBroker(const BrokerOptions& options)
+        : options(options), listenFd(-1), epollFd(-1), connections(), channels(), users(), delayed(),
+          finished(), nextMessageId(0) {}
+
+    ~StompBroker() {
+        for (auto& entry : connections) {
+            ::close(entry.first);
+        }
+        if (listenFd >= 0) ::close(listenFd);
+        if (epollFd >= 0) ::close(epollFd);
+    }
+
+    StompBroker(const StompBroker&) = delete;
+    StompBroker& operator=(const StompBroker&) = delete;
+
+    bool start();
+    void run();
+
+private:
+    BrokerOptions options;
+    int listenFd;
+    int epollFd;
+    std::map<int, std::unique_ptr<BrokerConnection>> connections;
+    std::map<std::string, std::map<int, std::string>> channels; // Channel -> fd -> subscription id
+    std::map<std::string, std::string> users;                   // Login -> passcode, registered on first CONNECT
+    std::deque<DelayedFrame> delayed;                           // Constant latency keeps this in due order
+    std::vector<int> finished;                                  // Connections to close after this round of events
+    long nextMessageId;
+
+    void accept();
+    void readFrom(BrokerConnection& connection);
+    void flush(BrokerConnection& connection);
+    void closeConnection(int fd);
+
+    // Close a connection once the current round of events is handled, so no handler
+    // is left holding a reference to it
+    void finish(BrokerConnection& connection);
+    int nextTimeout() const;
+    void releaseDelayed();
+
+    // Queue a frame for a connection, after the artificial latency if any
+    void send(BrokerConnection& connection, const std::string& frame, bool closeAfter = false);
+    void write(BrokerConnection& connection, const std::string& frame, bool closeAfter);
+
+    void process(BrokerConnection& connection, const char* data, size_t size);
+    void handleConnect(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt);
+    void handleSubscribe(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt);
+    void handleUnsubscribe(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt);
+    void handleSend(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt);
+    void handleDisconnect(BrokerConnection& connection, const StringSlice& receipt);
+    void sendReceipt(BrokerConnection& connection, const StringSlice& receipt, bool closeAfter = false);
+    void sendError(BrokerConnection& connection, const FrameView& frame, const std::string& message,
+                   const std::string& body, const StringSlice& receipt);
+    void unsubscribeAll(BrokerConnection& connection);
+};
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Trimmed header value, empty slice (null data) if missing
+static StringSlice headerValue(const FrameView& frame, const char* name) {
+    StringSlice value;
+    if (!frame.getHeader(name, value)) {
+        return StringSlice();
+    }
+    return value.trim();
+}
+
+static bool present(const StringSlice& slice) {
+    return slice.data != nullptr;
+}
+
+// Everything after the destination line, trimmed - the Java server's report body
+static std::string sendBody(const FrameView& frame) {
+    const char* end = frame.raw.data + frame.raw.size;
+    const char* line = frame.raw.data;
+    while (line < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        if (StringSlice(line, lineEnd - line).startsWith("destination:")) {
+            const char* begin = lineEnd < end ? lineEnd + 1 : end;
+            StringSlice body(begin, end - begin);
+            // trim() only strips spaces and tabs, Java's trim() also strips line breaks
+            while (body.size > 0 && static_cast<unsigned char>(body.data[0]) <= ' ') {
+                body = body.dropPrefix(1);
+            }
+            while (body.size > 0 && static_cast<unsigned char>(body.data[body.size - 1]) <= ' ') {
+                --body.size;
+            }
+            return body.str();
+        }
+        line = lineEnd + 1;
+    }
+    return std::string();
+}
+
+bool StompBroker::start() {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::perror("socket");
+        return false;
+    }
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, SOMAXCONN) < 0) {
+        std::perror("bind");
+        return false;
+    }
+    setNonBlocking(listenFd);
+
+    epollFd = epoll_create1(0);
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+}
+
+void StompBroker::run() {
+    std::vector<epoll_event> events(256);
+    while (true) {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), nextTimeout());
+        if (ready < 0 && errno != EINTR) {
+            std::perror("epoll_wait");
+            return;
+        }
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                accept();
+                continue;
+            }
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                flush(*found->second);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                readFrom(*found->second);
+            }
+        }
+        releaseDelayed();
+
+        for (int fd : finished) {
+            closeConnection(fd);
+        }
+        finished.clear();
+    }
+}
+
+void StompBroker::accept() {
+    while (true) {
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        setNonBlocking(fd);
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        connections[fd].reset(new BrokerConnection(fd));
+    }
+}
+
+void StompBroker::readFrom(BrokerConnection& connection) {
+    char buffer[1 << 16];
+    bool peerClosed = false;
+    while (true) {
+        ssize_t bytes = ::read(connection.fd, buffer, sizeof(buffer));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            peerClosed = bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+        connection.input.insert(connection.input.end(), buffer, buffer + bytes);
+    }
+
+    // Handle every complete frame, stopping at one that ends the session
+    size_t start = 0;
+    while (!connection.closing) {
+        const char* begin = connection.input.data() + start;
+        const char* end = static_cast<const char*>(std::memchr(begin, '\0', connection.input.size() - start));
+        if (!end) {
+            break;
+        }
+        start += end + 1 - begin;
+        process(connection, begin, end - begin);
+    }
+    connection.input.erase(connection.input.begin(), connection.input.begin() + start);
+    if (peerClosed) {
+        finish(connection);
+    }
+}
+
+void StompBroker::flush(BrokerConnection& connection) {
+    while (!connection.output.empty()) {
+        ssize_t bytes = ::send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (bytes < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            connection.output.clear();
+            finish(connection);
+            return;
+        }
+        connection.output.erase(0, bytes);
+    }
+
+    if (connection.output.empty() && connection.closeAfterFlush) {
+        finish(connection);
+        return;
+    }
+    // Only ask for EPOLLOUT while something is waiting
+    bool wantsWrite = !connection.output.empty();
+    if (wantsWrite != connection.wantsWrite) {
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | (wantsWrite ? EPOLLOUT : 0);
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.wantsWrite = wantsWrite;
+    }
+}
+
+void StompBroker::finish(BrokerConnection& connection) {
+    connection.closing = true;
+    if (std::find(finished.begin(), finished.end(), connection.fd) == finished.end()) {
+        finished.push_back(connection.fd);
+    }
+}
+
+void StompBroker::closeConnection(int fd) {
+    auto found = connections.find(fd);
+    if (found == connections.end()) {
+        return;
+    }
+    unsubscribeAll(*found->second);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections.erase(found);
+}
+
+int StompBroker::nextTimeout() const {
+    if (delayed.empty()) {
+        return -1;
+    }
+    long millis = std::chrono::duration_cast<std::chrono::milliseconds>(delayed.front().due - Clock::now()).count();
+    return static_cast<int>(millis < 0 ? 0 : millis + 1);
+}
+
+void StompBroker::releaseDelayed() {
+    Clock::time_point now = Clock::now();
+    while (!delayed.empty() && delayed.front().due <= now) {
+        DelayedFrame frame = std::move(delayed.front());
+        delayed.pop_front();
+        auto found = connections.find(frame.fd);
+        if (found != connections.end()) {
+            write(*found->second, frame.frame, frame.closeAfter);
+        }
+    }
+}
+
+void StompBroker::send(BrokerConnection& connection, const std::string& frame, bool closeAfter) {
+    std::string wire = frame;
+    if (!wire.empty()) {
+        wire.push_back('\0');
+    }
+    connection.closing = connection.closing || closeAfter;
+    if (options.latencyMicros <= 0) {
+        write(connection, wire, closeAfter);
+        return;
+    }
+    delayed.push_back(DelayedFrame(Clock::now() + std::chrono::microseconds(options.latencyMicros),
+                                   connection.fd, std::move(wire), closeAfter));
+}
+
+void StompBroker::write(BrokerConnection& connection, const std::string& frame, bool closeAfter) {
+    connection.output += frame;
+    connection.closeAfterFlush = connection.closeAfterFlush || closeAfter;
+    flush(connection);
+}
+
+void StompBroker::process(BrokerConnection& connection, const char* data, size_t size) {
+    FrameView frame;
+    if (!frame.parse(data, size)) {
+        return; // Heart-beat
+    }
+    StringSlice receipt = headerValue(frame, "receipt");
+
+    if (frame.command.equals("CONNECT")) {
+        handleConnect(connection, frame, receipt);
+    } else if (frame.command.equals("SUBSCRIBE")) {
+        handleSubscribe(connection, frame, receipt);
+    } else if (frame.command.equals("UNSUBSCRIBE")) {
+        handleUnsubscribe(connection, frame, receipt);
+    } else if (frame.command.equals("SEND")) {
+        handleSend(connection, frame, receipt);
+    } else if (frame.command.equals("DISCONNECT")) {
+        handleDisconnect(connection, receipt);
+    } else {
+        sendError(connection, frame, "Unknown command", "Invalid STOMP command: " + frame.command.str(), receipt);
+    }
+}
+
+void StompBroker::handleConnect(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt) {
+    StringSlice login = headerValue(frame, "login");
+    StringSlice passcode = headerValue(frame, "passcode");
+    if (!present(login) || !present(passcode)) {
+        sendError(connection, frame, "Malformed frame", "CONNECT frame missing login or passcode.", receipt);
+        return;
+    }
+    std::string user = login.str();
+    for (auto& entry : connections) {
+        if (entry.second->user == user) {
+            sendError(connection, frame, "User already logged in", "The user is already connected.", receipt);
+            return;
+        }
+    }
+    auto registered = users.find(user);
+    if (registered == users.end()) {
+        users[user] = passcode.str();
+    } else if (registered->second != passcode.str()) {
+        sendError(connection, frame, "Invalid credentials", "The provided login or passcode is incorrect.", receipt);
+        return;
+    }
+    connection.user = user;
+    send(connection, "CONNECTED\nversion:1.2\n\n");
+    sendReceipt(connection, receipt);
+}
+
+void StompBroker::handleSubscribe(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt) {
+    StringSlice destination = headerValue(frame, "destination");
+    StringSlice id = headerValue(frame, "id");
+    if (!present(destination) || !present(id)) {
+        sendError(connection, frame, "Malformed frame", "SUBSCRIBE frame missing destination or id.", receipt);
+        return;
+    }
+    std::map<int, std::string>& subscribers = channels[destination.str()];
+    if (subscribers.count(connection.fd)) {
+        sendError(connection, frame, "Already signed in", "You are already signed in to this channel", receipt);
+        return;
+    }
+    subscribers[connection.fd] = id.str();
+    connection.subscriptions[id.str()] = destination.str();
+    sendReceipt(connection, receipt);
+}
+
+void StompBroker::handleUnsubscribe(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt) {
+    StringSlice id = headerValue(frame, "id");
+    if (!present(id)) {
+        sendError(connection, frame, "Malformed frame", "UNSUBSCRIBE frame missing id.", receipt);
+        return;
+    }
+    auto subscription = connection.subscriptions.find(id.str());
+    if (subscription == connection.subscriptions.end()) {
+        sendError(connection, frame, "Wrong channel request", "You are not subscribed to this channel", receipt);
+        return;
+    }
+    channels[subscription->second].erase(connection.fd);
+    connection.subscriptions.erase(subscription);
+    sendReceipt(connection, receipt);
+}
+
+void StompBroker::handleSend(BrokerConnection& connection, const FrameView& frame, const StringSlice& receipt) {
+    StringSlice destinationHeader = headerValue(frame, "destination");
+    if (!present(destinationHeader)) {
+        sendError(connection, frame, "Malformed frame", "SEND frame missing destination.", receipt);
+        return;
+    }
+    std::string destination = destinationHeader.str();
+    auto channel = channels.find(destination);
+    if (channel == channels.end() || !channel->second.count(connection.fd)) {
+        sendError(connection, frame, "Cannot send report", "You are not subscribed to this channel", receipt);
+        return;
+    }
+
+    std::string body = sendBody(frame);
+    for (int copy = 0; copy < options.fanout; ++copy) {
+        for (auto& subscriber : channel->second) {
+            if (subscriber.first == connection.fd) {
+                continue; // Senders do not get their own reports
+            }
+            send(*connections[subscriber.first], "MESSAGE\nsubscription:" + subscriber.second + "\nmessage-id:" +
+                                                 std::to_string(nextMessageId++) + "\ndestination:" + destination +
+                                                 "\n\n" + body + "\n\n");
+        }
+    }
+    sendReceipt(connection, receipt);
+}
+
+void StompBroker::handleDisconnect(BrokerConnection& connection, const StringSlice& receipt) {
+    unsubscribeAll(connection);
+    connection.user.clear();
+    if (present(receipt)) {
+        sendReceipt(connection, receipt, true);
+    } else {
+        send(connection, std::string(), true);
+    }
+}
+
+void StompBroker::sendReceipt(BrokerConnection& connection, const StringSlice& receipt, bool closeAfter) {
+    if (present(receipt)) {
+        send(connection, "RECEIPT\nreceipt-id:" + receipt.str() + "\n\n", closeAfter);
+    }
+}
+
+void StompBroker::sendError(BrokerConnection& connection, const FrameView& frame, const std::string& message,
+                            const std::string& body, const StringSlice& receipt) {
+    std::string error = present(receipt) ? "ERROR\nreceipt-id: " + receipt.str() + "\nmessage: " + message
+                                         : "ERROR\nmessage:" + message;
+    error += "\n\nThe message:\n-----\n" + frame.raw.str() + "\n-----\n" + body + "\n\n";
+    unsubscribeAll(connection);
+    connection.user.clear();
+    send(connection, error, true);
+}
+
+void StompBroker::unsubscribeAll(BrokerConnection& connection) {
+    for (auto& subscription : connection.subscriptions) {
+        auto channel = channels.find(subscription.second);
+        if (channel != channels.end()) {
+            channel->second.erase(connection.fd);
+        }
+    }
+    connection.subscriptions.clear();
+}
+
+static bool parseOptions(int argc, char* argv[], BrokerOptions& options) {
+    if (argc < 2) {
+        return false;
+    }
+    options.port = std::atoi(argv[1]);
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--latency") {
+            options.latencyMicros = std::atol(argv[i + 1]);
+        } else if (flag == "--fanout") {
+            options.fanout = std::atoi(argv[i + 1]);
+        } else {
+            return false;
+        }
+    }
+    return options.port > 0 && options.port < 65536 && options.fanout > 0;
+}
+
+int main(int argc, char* argv[]) {
+    BrokerOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cout << "Usage: StompBroker {port} [--latency microseconds] [--fanout N]" << std::endl;
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    StompBroker broker(options);
+    if (!broker.start()) {
+        return 1;
+    }
+    std::cout << "Broker listening on 127.0.0.1:" << options.port << std::endl;
+    broker.run();
+    return 0;
+}
@@ -4,227 +4,65 @@
 #include <memory>
 #include <chrono>
 #include "../include/StompProtocol.h"
+#include "../include/SessionManager.h"
 #include <sstream>
 #include <iostream>
 #include <fstream>
 #include <csignal>
 #include "ConcurrentHashMap.h"
+#include "StompFrameParser.h"
 #include <map>
 
 
 using namespace std;
 
-// Global variables
-mutex myLock, waitLock;
-condition_variable var;
-string user = "";
-bool handlerConnected = false; // Physical connection
-std::thread* listenerThreadPtr = nullptr; // Global thread pointer for signal handling
-
-
-int getReceiptId(const std::string& frame){
-    const std::string receiptPrefix = "receipt-id:";
-    size_t pos = frame.find(receiptPrefix);
-
-    if (pos != std::string::npos) {
-        pos += receiptPrefix.length(); // Move to the start of the ID
-        size_t endPos = frame.find('\n', pos); // Find the end of the line
-
-        std::string receiptIdStr = (endPos != std::string::npos)
-            ? frame.substr(pos, endPos - pos) // Extract ID until the newline
-            : frame.substr(pos);              // Extract the rest if no newline
-
-        // Convert the extracted receipt ID to an integer
-        return std::stoi(receiptIdStr);
-    }
-
-    return -1;
-}
-
-//check if got the disconnection one
-bool compareReceiptId(const std::string& frame, int id) {
-    const std::string receiptPrefix = "receipt-id:";
-    size_t pos = frame.find(receiptPrefix);
-
-    if (pos != std::string::npos) {
-        pos += receiptPrefix.length(); // Move to the start of the ID
-        size_t endPos = frame.find('\n', pos); // Find the end of the line
-
-        std::string receiptIdStr = (endPos != std::string::npos)
-            ? frame.substr(pos, endPos - pos) // Extract ID until the newline
-            : frame.substr(pos);              // Extract the rest if no newline
-
-        // Convert the extracted receipt ID to an integer
-        int extractedId = std::stoi(receiptIdStr);
-        return extractedId == id; // Compare the extracted ID with the given ID
-    }
-
-    return false; // Return false if receipt-id is not found
-}
-
-
-// Function to process frames received from the server
-void processFrame(const std::string& frame, StompProtocol& protocol, ConnectionHandler* handler) {
-    std::istringstream response(frame);
-    string command;
-    response >> command;
-
-    if (command == "CONNECTED") {
-        protocol.isLogicConnected.store(true);
-        std::cout << "Login successful!\n";
-    } 
-
-else if (command == "MESSAGE") {
-    //std::cout << "" << frame << std::endl;
-
-    // Parse the MESSAGE frame
-    std::string channel, user, eventName, description, city;
-    int dateTime = 0;
-    std::map<std::string, std::string> generalInfo;
-    bool inDescription = false;
-    bool inGeneralInfo = false;
-
-    std::istringstream frameStream(frame);
-    std::string line;
-
-    while (std::getline(frameStream, line)) {
-        if (line.find("destination:") == 0) {
-            channel = line.substr(12);
-        } else if (line.find("user:") == 0) {
-            user = line.substr(5);
-        } else if (line.find("city:") == 0) {
-            city = line.substr(5);
-        } else if (line.find("event name:") == 0) {
-            eventName = line.substr(11);
-        } else if (line.find("date time:") == 0) {
-            dateTime = std::stoi(line.substr(10));
-        } else if (line.find("general information:") == 0) {
-            // Start parsing the general information block
-            inGeneralInfo = true;
-            continue;
-        } else if (line.find("description:") == 0) {
-            // Start parsing the description block
-            description = line.substr(12);
-            inDescription = true;
-            inGeneralInfo = false; // End general info block
-        }
-
-        // Handle general information block (multi-line)
-        else if (inGeneralInfo) {
-            if (line.empty() || line.find(":") == std::string::npos) {
-                inGeneralInfo = false; // Stop parsing general information if invalid format
-            } else {
-                size_t colonPos = line.find(":");
-                if (colonPos != std::string::npos) {
-                    std::string key = line.substr(0, colonPos);
-                    std::string value = line.substr(colonPos + 1);
-                    // Trim whitespace
-                    key.erase(0, key.find_first_not_of(" \t"));
-                    key.erase(key.find_last_not_of(" \t") + 1);
-                    value.erase(0, value.find_first_not_of(" \t"));
-                    value.erase(value.find_last_not_of(" \t") + 1);
-
-                    generalInfo[key] = value;
-                }
-            }
-        }
+int main(int argc, char *argv[]) {
 
-        // Handle multi-line description
-        else if (inDescription) {
-            if (line.empty() || line.find(":") != std::string::npos) {
-                inDescription = false; // Stop collecting description on encountering a new field
-            } else {
-                description += line; // Append
-            }
+    // A single session, its frames are processed on the session manager's io thread
+    SessionManager sessions(1);
+    std::shared_ptr<Session> session = sessions.createSession(&std::cout);
+    StompProtocol& protocol = session->getProtocol();
+
+    // --columnar keeps received events as columns too, for the stats command.
+    // --journal {file} keeps stored events on disk and restores them on the next start,
+    // --journal-sync syncs the journal after every write.
+    // --snapshot {file} loads a snapshot first and is where the snapshot command writes,
+    // the journal then only replays what came after the snapshot.
+    std::string journalPath;
+    std::string snapshotPath;
+    EventJournal::SyncPolicy journalSync = EventJournal::NO_SYNC;
+    for (int i = 1; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--columnar") {
+            protocol.getSummaryManager().setColumnar(true);
+        } else if (option == "--journal" && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (option == "--journal-sync") {
+            journalSync = EventJournal::SYNC_EACH_COMMIT;
+        } else if (option == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
         }
     }
-
-    // Create and store the event
-    Event event(channel, city, eventName, dateTime, description, generalInfo);
-    protocol.getSummaryManager().addEvent(channel, user, event);
-}
-
-
-    else if (command == "RECEIPT") {
-        //std::cout << "Receipt received: " << frame << std::endl;
-        bool needDisconnect = compareReceiptId(frame, protocol.sentDisconnect.load());
-        int id = getReceiptId(frame);
-        // Find and delete the pair with the specified ID
-        if(protocol.receiptIDToMessageMap.contains(id)){
-            cout << protocol.receiptIDToMessageMap.getValue(id) << endl;
-            protocol.receiptIDToMessageMap.remove(id);
-        }
-        //gracefull disconnection
-        if(needDisconnect){
-            protocol.getSummaryManager().clearClientData(user);
-            protocol.receiptIDToMessageMap.clear();
-            protocol.isLogicConnected.store(false);
-            protocol.sentDisconnect.store(-1);;
-            protocol.channelToSubcriptonID.clear();
-            handler->close();
-            {
-                std::lock_guard<std::mutex> lock(myLock);
-                handlerConnected = false;
-            }
-            var.notify_all();
+    uint64_t journalCovered = 0;
+    if (!snapshotPath.empty()) {
+        size_t loaded = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (!protocol.getSummaryManager().loadSnapshot(snapshotPath, &journalCovered, &loaded)) {
+            return 1;
         }
-
-
-    } 
-    else if (command == "ERROR") {
-        std::cout << "" << frame << std::endl;
-        protocol.getSummaryManager().clearClientData(user);
-        protocol.receiptIDToMessageMap.clear();
-        protocol.isLogicConnected.store(false);
-        protocol.sentDisconnect.store(-1);
-        protocol.channelToSubcriptonID.clear();
-        handler->close();
-        {
-            std::lock_guard<std::mutex> lock(myLock);
-            handlerConnected = false;
-        }
-        var.notify_all();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Loaded " << loaded << " events from " << snapshotPath << " in " << elapsed.count() << " ms\n";
     }
-}
-
-// Thread responsible for listening to the server
-void listen(ConnectionHandler *&handler, StompProtocol &protocol) {
-    while (true) {
-        std::unique_lock<std::mutex> varLock(waitLock);
-        var.wait(varLock, [] { return handlerConnected; });
-
-        if (!handler) {
-            std::cout << "Handler is null. Exiting listener thread.\n";
-            return;
-        }
-
-        while (handlerConnected) {
-            std::string response;
-            if (handlerConnected && !handler->getLine(response)) {
-                std::cout << "Connection closed by server or error occurred. Disconnecting listener.\n";
-                {
-                    std::lock_guard<std::mutex> lock(myLock);
-                    handlerConnected = false;
-                }
-                var.notify_all();
-                break;
-            }
-
-            processFrame(response, protocol, handler);
-            //std::cout << response << std::endl;
+    if (!journalPath.empty()) {
+        size_t restored = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (!protocol.getSummaryManager().openJournal(journalPath, journalSync, &restored, journalCovered)) {
+            return 1;
         }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Restored " << restored << " events from " << journalPath << " in " << elapsed.count()
+                  << " ms\n";
     }
-}
-
-
-int main(int argc, char *argv[]) {
-
-    // Run listener thread
-    ConnectionHandler *handler = nullptr;
-    StompProtocol protocol;
-
-    std::thread listenerThread([&]() { listen(handler, protocol); });
-    listenerThreadPtr = &listenerThread;
 
     // Read from keyboard
     while (1) {
@@ -237,7 +75,7 @@ int main(int argc, char *argv[]) {
         input >> command;
 
         // Handle not logged in
-        if (command != "login" && (!protocol.isLogicConnected.load() || !handlerConnected)) {
+        if (command != "login" && (!session->isLoggedIn() || !session->isConnected())) {
             std::cout << "Please login first. Format - login {host:port} {username} {password}\n";
             continue;
         }
@@ -282,31 +120,19 @@ int main(int argc, char *argv[]) {
             }
 
             // Establish connection
-            if (handler != nullptr) {
-                delete handler;
-            }
-            handler = new ConnectionHandler(host, port);
-            if (!handler->connect()) {
+            if (!session->connect(host, port)) {
                 std::cout << "Cannot connect to " << host << ":" << port << std::endl;
                 continue;
             }
 
-            {
-                std::lock_guard<std::mutex> lock(myLock);
-                handlerConnected = true;
-            }
-            var.notify_all();
-
-            string connectFrame = protocol.constructConnectFrame(username, password);
-            if (!handler->sendLine(connectFrame)) {
+            if (!session->login(username, password)) {
                 std::cout << "Couldn't send frame\n";
                 continue;
             }
-            user = username;
         }
         else if (command == "logout") {
             string disconnectFrame = protocol.constructDisconnectFrame();
-            if (!handler->sendLine(disconnectFrame)) {
+            if (!session->sendAndWait(disconnectFrame)) {
                 std::cout << "Couldn't send frame\n";
                 continue;
             }
@@ -321,7 +147,7 @@ int main(int argc, char *argv[]) {
             }
 
             string joinFrame = protocol.constructSubscribeFrame(channel);
-            if (!handler->sendLine(joinFrame)) {
+            if (!session->sendAndWait(joinFrame)) {
                 std::cout << "Couldn't send frame\n";
                 continue;
             }
@@ -336,7 +162,7 @@ int main(int argc, char *argv[]) {
             }
 
             string unsubscribeFrame = protocol.constructUnsubscribeFrame(channel);
-            if (!handler->sendLine(unsubscribeFrame)) {
+            if (!session->sendAndWait(unsubscribeFrame)) {
                 std::cout << "Couldn't send frame\n";
                 continue;
             }
@@ -344,14 +170,20 @@ int main(int argc, char *argv[]) {
         else if (command == "report") {
             string path;
             input >> path;
-            std::vector<std::string> reportFrames = protocol.constructReportFrames(path, user);
-
-            for (string& frame : reportFrames) {
-                if (!handler->sendLine(frame)) {
-                    std::cout << "Couldn't send frame\n";
-                    continue;
-                }
+            // Frames leave in batches while the rest of the report is still being built
+            parse_stats stats;
+            bool sent = protocol.streamReportFrames(path, session->getUser(), ConnectionHandler::DEFAULT_SEND_BATCH_SIZE,
+                [&session](const FrameWriter& batch) {
+                    return session->sendAndWait(batch);
+                }, &stats);
+
+            if (!sent) {
+                std::cout << "Couldn't send frame\n";
+                continue;
             }
+            std::cout << "Parsed " << stats.events << " events from " << path << " ("
+                      << stats.megabytes_per_second() << " MB/s, "
+                      << stats.events_per_second() << " events/s)" << std::endl;
         }
         
     else if (command == "summary") {
@@ -381,18 +213,153 @@ int main(int argc, char *argv[]) {
         protocol.getSummaryManager().generateSummary(channelName, clientName, summaryFile);
         }
 
+        else if (command == "range") {
+            std::string channelName, fromStr, toStr;
+            input >> channelName >> fromStr >> toStr;
+
+            int from, to;
+            try {
+                from = std::stoi(fromStr);
+                to = std::stoi(toStr);
+            } catch (std::exception& e) {
+                std::cout << "Bad format: range {channelName} {from epoch seconds} {to epoch seconds}" << std::endl;
+                continue;
+            }
+
+            if (!protocol.channelToSubcriptonID.contains(channelName)) {
+                std::cout << "You are not subscribed to the channel: " << channelName << std::endl;
+                continue;
+            }
+
+            SummaryManager& summaries = protocol.getSummaryManager();
+            std::vector<EventRecord> events = summaries.eventsBetween(channelName, from, to);
+            std::cout << events.size() << " events on " << channelName << " between "
+                      << summaries.epochToDate(from) << " and " << summaries.epochToDate(to) << std::endl;
+            for (const EventRecord& event : events) {
+                std::cout << summaries.epochToDate(event.dateTime) << " " << *event.city << ": "
+                          << *event.name << " (" << *event.user << ")" << std::endl;
+            }
+        }
+
+        else if (command == "stats") {
+            std::string channelName, fromStr, widthStr, bucketsStr;
+            input >> channelName >> fromStr >> widthStr >> bucketsStr;
+
+            // The histogram arguments are optional, but all or none
+            int from = 0, width = 0, buckets = 0;
+            bool withHistogram = !fromStr.empty();
+            try {
+                if (withHistogram) {
+                    from = std::stoi(fromStr);
+                    width = std::stoi(widthStr);
+                    buckets = std::stoi(bucketsStr);
+                }
+            } catch (std::exception& e) {
+                width = 0;
+            }
+            if (channelName.empty() || (withHistogram && (width <= 0 || buckets <= 0 ||
+                                           static_cast<size_t>(buckets) > SummaryManager::MAX_HISTOGRAM_BUCKETS))) {
+                std::cout << "Bad format: stats {channelName} [{from epoch seconds} {bucket seconds} {buckets}]" << std::endl;
+                continue;
+            }
+
+            SummaryManager& summaries = protocol.getSummaryManager();
+            if (!summaries.isColumnar()) {
+                std::cout << "Channel statistics need the client to be started with --columnar" << std::endl;
+                continue;
+            }
+
+            if (!protocol.channelToSubcriptonID.contains(channelName)) {
+                std::cout << "You are not subscribed to the channel: " << channelName << std::endl;
+                continue;
+            }
+
+            ColumnCounts counts = summaries.channelCounts(channelName);
+            std::cout << "Channel " << channelName << "\n"
+                      << "Total: " << counts.total << "\n"
+                      << "active: " << counts.active << "\n"
+                      << "forces arrival at scene: " << counts.forcesArrival << "\n"
+                      << "active with forces at scene: " << counts.activeWithForces << "\n"
+                      << "By city:\n";
+            for (const std::pair<Symbol, size_t>& city : summaries.countByCity(channelName)) {
+                std::cout << " " << *city.first << ": " << city.second << "\n";
+            }
+            if (withHistogram) {
+                std::cout << "By time:\n";
+                std::vector<size_t> counted = summaries.histogram(channelName, from, width, buckets);
+                for (size_t i = 0; i < counted.size(); ++i) {
+                    // Wide buckets can take a label past the range of int
+                    int64_t start = static_cast<int64_t>(from) + static_cast<int64_t>(i) * width;
+                    std::cout << " " << summaries.epochToDate(start) << ": "
+                              << counted[i] << "\n";
+                }
+            }
+            std::cout << std::flush;
+        }
+
+        else if (command == "recent") {
+            std::string channelName, countStr, city;
+            input >> channelName >> countStr;
+            std::getline(input, city);
+
+            // City names may contain spaces, take the rest of the line
+            if (!city.empty() && city[0] == ' ') {
+                city = city.substr(1);
+            }
+
+            int count;
+            try {
+                count = std::stoi(countStr);
+            } catch (std::exception& e) {
+                count = -1;
+            }
+            if (count < 0 || city.empty()) {
+                std::cout << "Bad format: recent {channelName} {count} {city}" << std::endl;
+                continue;
+            }
+
+            if (!protocol.channelToSubcriptonID.contains(channelName)) {
+                std::cout << "You are not subscribed to the channel: " << channelName << std::endl;
+                continue;
+            }
+
+            SummaryManager& summaries = protocol.getSummaryManager();
+            std::vector<EventRecord> events = summaries.latestInCity(channelName, city, count);
+            std::cout << events.size() << " latest events on " << channelName << " in " << city << std::endl;
+            for (const EventRecord& event : events) {
+                std::cout << summaries.epochToDate(event.dateTime) << " " << *event.name << " ("
+                          << *event.user << ")" << std::endl;
+            }
+        }
+
+        else if (command == "snapshot") {
+            std::string path;
+            input >> path;
+            if (path.empty()) {
+                path = snapshotPath;
+            }
+            if (path.empty()) {
+                std::cout << "Bad format: snapshot {file}, or start the client with --snapshot {file}" << std::endl;
+                continue;
+            }
+
+            // Written on a background thread, errors are reported there
+            // Only the snapshot loaded at start may let the journal drop what it covers
+            if (!protocol.getSummaryManager().writeSnapshot(path, path == snapshotPath)) {
+                std::cout << "A snapshot is still being written" << std::endl;
+                continue;
+            }
+            std::cout << "Writing snapshot to " << path << std::endl;
+        }
+
         else {
             std::cout << "Unknown request\n";
             continue;
         }
     }
 
-    // Join listener thread and cleanup
-    listenerThread.join();
-    if (handler) {
-        handler->close();
-        delete handler;
-    }
+    // Close the session and stop the io thread
+    sessions.stop();
 
     std::cout << "Client shutdown complete.\n";
     return 0;
@@ -0,0 +1,236 @@
+#include "../include/EventSorter.h"
+#include "../include/FrameWriter.h"
+#include "../include/StompFrameParser.h"
+#include "../include/SummaryManager.h"
+#include "../include/event.h"
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+// Copy and allocation benchmark: every heap allocation is counted through a replaced global
+// operator new while events go the two ways they are stored, stage by stage. The receive path
+// parses MESSAGE frames into an EventReportView, builds an Event and hands it to the summary;
+// the report path parses an events file, sorts it and hands each event to the summary.
+// Descriptions are made longer than any other string, so an allocation that size or larger
+// is what a copy of an event's description would take. Storing copies a description into
+// the bucket's arena exactly once, so the store stages may only see the arena's and the
+// indexes' amortized growth there; a redundant copy shows up as one more per event.
+//
+// Usage: StompCopyBench [events, at least 10000]
+
+static std::atomic<size_t> newCalls(0);
+static std::atomic<size_t> newBytes(0);
+static std::atomic<size_t> deleteCalls(0);
+static std::atomic<size_t> newDescriptionSized(0); // Allocations that could hold a description
+static size_t descriptionBytes = SIZE_MAX;      // Set once the descriptions are built
+
+void* operator new(size_t size) {
+    ++newCalls;
+    newBytes += size;
+    if (size >= descriptionBytes) {
+        ++newDescriptionSized;
+    }
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    if (memory) {
+        ++deleteCalls;
+        std::free(memory);
+    }
+}
+
+static const size_t DESCRIPTION_LENGTH = 256;
+static const size_t MIN_EVENTS = 10000;
+static const char* CITIES[] = {"Springfield", "Shelbyville", "Ogdenville", "North Haverbrook"};
+static const char* CHANNEL = "/emergency/police";
+
+// The counters as one stage left them
+struct Counts {
+    size_t allocations;
+    size_t bytes;
+    size_t frees;
+    size_t descriptionSized;
+
+    static Counts now() {
+        Counts counts = {newCalls.load(), newBytes.load(), deleteCalls.load(), newDescriptionSized.load()};
+        return counts;
+    }
+};
+
+// Per event counts of a stage, returning its description sized allocations per event
+static double report(const char* stage, const Counts& before, size_t events) {
+    Counts after = Counts::now();
+    double perEvent = 1.0 / events;
+    double sized = (after.descriptionSized - before.descriptionSized) * perEvent;
+    std::cout << std::fixed << std::setprecision(3) << std::setw(10)
+              << (after.allocations - before.allocations) * perEvent << std::setw(12) << std::setprecision(1)
+              << (after.bytes - before.bytes) * perEvent << std::setw(10) << std::setprecision(3)
+              << (after.frees - before.frees) * perEvent << std::setw(14) << sized << "  " << stage << std::endl;
+    return sized;
+}
+
+static std::string description(size_t i) {
+    std::string text = "report " + std::to_string(i) + " ";
+    text.append(DESCRIPTION_LENGTH - text.size(), static_cast<char>('a' + i % 26));
+    return text;
+}
+
+// MESSAGE frames as the server forwards reports, each with its null delimiter
+static std::vector<std::string> buildFrames(size_t events) {
+    std::vector<std::string> frames;
+    for (size_t i = 0; i < events; ++i) {
+        FrameWriter writer;
+        writer.command("MESSAGE")
+              .header("subscription", 0L)
+              .header("message-id", static_cast<long>(i))
+              .header("destination", std::string(CHANNEL))
+              .endHeaders()
+              .header("user", std::string("bench"))
+              .header("city", std::string(CITIES[i % 4]))
+              .header("event name", std::string("event ") + std::to_string(i % 7))
+              .header("date time", 1700000000L + static_cast<long>(i) * 60)
+              .append("general information:\n")
+              .append(i % 2 == 0 ? " active: true\n" : " active: false\n")
+              .append(" forces_arrival_at_scene: false\n")
+              .append("description:\n")
+              .append(description(i))
+              .append("\n\n");
+        writer.endFrame();
+        frames.push_back(writer.takeFrame());
+    }
+    return frames;
+}
+
+// The same events as an events file, listed newest first so the sorter has work to do
+static bool writeEventsFile(const std::string& path, size_t events) {
+    std::ofstream out(path);
+    out << "{\"channel_name\": \"" << CHANNEL << "\", \"events\": [\n";
+    for (size_t i = events; i-- > 0;) {
+        out << "{\"event_name\": \"event " << i % 7 << "\", \"city\": \"" << CITIES[i % 4]
+            << "\", \"date_time\": " << 1700000000L + static_cast<long>(i) * 60 << ", \"description\": \""
+            << description(i) << "\", \"general_information\": {\"active\": " << (i % 2 == 0 ? "true" : "false")
+            << ", \"forces_arrival_at_scene\": false}}" << (i > 0 ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return static_cast<bool>(out.flush());
+}
+
+int main(int argc, char* argv[]) {
+    // Enough events that the arena's chunks and the indexes' growth average out
+    size_t events = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    events = std::max(events, MIN_EVENTS);
+
+    std::vector<std::string> frames = buildFrames(events);
+    char path[] = "/tmp/StompCopyBench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (fd < 0 || !writeEventsFile(path, events)) {
+        std::cerr << "Cannot write a temporary events file" << std::endl;
+        return 1;
+    }
+    descriptionBytes = DESCRIPTION_LENGTH;
+
+    std::cout << events << " events of " << DESCRIPTION_LENGTH << " byte descriptions, per event:" << std::endl;
+    std::cout << std::setw(10) << "allocs" << std::setw(12) << "bytes" << std::setw(10) << "frees" << std::setw(14)
+              << "descr-sized" << "  stage" << std::endl;
+
+    // Receive path, a stage at a time over every frame
+    std::vector<Event> received;
+    received.reserve(events);
+    Counts before = Counts::now();
+    std::vector<EventReportView> reports(events);
+    for (size_t i = 0; i < events; ++i) {
+        FrameView frame;
+        StompFrameParser::parse(frames[i].data(), frames[i].size() - 1, frame);
+        StompFrameParser::parseEventReport(frame, reports[i]);
+    }
+    report("receive: parse frame and event report", before, events);
+
+    before = Counts::now();
+    for (EventReportView& view : reports) {
+        received.emplace_back(view.channel.str(), view.city.str(), view.eventName.str(), view.dateTime,
+                              std::move(view.description), std::move(view.generalInformation));
+    }
+    report("receive: build Event", before, events);
+
+    // The store gets identical events both ways, each into a fresh summary
+    std::vector<Event> copies;
+    copies.reserve(events);
+    for (const Event& event : received) {
+        copies.emplace_back(event.get_channel_name(), event.get_city(), event.get_name(), event.get_date_time(),
+                            event.get_description(), event.get_general_information());
+    }
+    std::string channel(CHANNEL), user("bench");
+    double storeSized;
+    {
+        SummaryManager summaries;
+        before = Counts::now();
+        for (const Event& event : copies) {
+            summaries.addEvent(channel, user, event);
+        }
+        storeSized = report("store: addEvent(const Event&)", before, events);
+    }
+    {
+        SummaryManager summaries;
+        before = Counts::now();
+        for (Event& event : received) {
+            summaries.addEvent(channel, user, std::move(event));
+        }
+        storeSized = std::max(storeSized, report("store: addEvent(Event&&), the receive path", before, events));
+    }
+
+    // Report path: parse and sort, then store the way streamReportFrames does
+    {
+        SummaryManager summaries;
+        EventSorter sorter;
+        parse_stats stats;
+        before = Counts::now();
+        std::string fileChannel =
+            parseEventsFileStreaming(path, [&sorter](Event& event) { sorter.add(event); }, &stats);
+        report("report: parse events file into the sorter", before, events);
+
+        before = Counts::now();
+        Counts stored = {0, 0, 0, 0};
+        sorter.finish(fileChannel, [&](Event& event) {
+            Counts start = Counts::now();
+            summaries.addEvent(fileChannel, user, std::move(event));
+            Counts end = Counts::now();
+            stored.allocations += end.allocations - start.allocations;
+            stored.bytes += end.bytes - start.bytes;
+            stored.frees += end.frees - start.frees;
+            stored.descriptionSized += end.descriptionSized - start.descriptionSized;
+            return true;
+        });
+        report("report: sorted events out of the sorter and stored", before, events);
+        double perEvent = 1.0 / events;
+        std::cout << std::fixed << std::setprecision(3) << std::setw(10) << stored.allocations * perEvent
+                  << std::setw(12) << std::setprecision(1) << stored.bytes * perEvent << std::setw(10)
+                  << std::setprecision(3) << stored.frees * perEvent << std::setw(14)
+                  << stored.descriptionSized * perEvent << "  report: of which addEvent(Event&&)" << std::endl;
+        storeSized = std::max(storeSized, stored.descriptionSized * perEvent);
+    }
+    std::remove(path);
+
+    // Arena chunks and index growth come to a few hundredths of an allocation per event
+    if (storeSized >= 0.1) {
+        std::cerr << "Storing an event copies its description more than once" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include "../include/StompFrameParser.h"
+#include "../include/StructuralIndex.h"
+#include <cstring>
+
+EventReportView::EventReportView()
+    : channel(), user(), city(), eventName(), dateTime(0), description(), generalInformation() {}
+
+// Compare a token against a name of the same, already checked, length
+static bool sameName(const char* token, const char* name, size_t length) {
+    return std::memcmp(token, name, length) == 0;
+}
+
+// Slice of [begin, end) without a trailing carriage return
+static StringSlice lineSlice(const char* begin, const char* end) {
+    if (end > begin && end[-1] == '\r') {
+        --end;
+    }
+    return StringSlice(begin, end - begin);
+}
+
+StompCommand StompFrameParser::classifyCommand(const char* name, size_t length) {
+    switch (length) {
+        case 5:
+            if (sameName(name, "ERROR", 5)) return StompCommand::ERROR;
+            break;
+        case 7:
+            if (name[0] == 'M' && sameName(name, "MESSAGE", 7)) return StompCommand::MESSAGE;
+            if (name[0] == 'R' && sameName(name, "RECEIPT", 7)) return StompCommand::RECEIPT;
+            break;
+        case 9:
+            if (sameName(name, "CONNECTED", 9)) return StompCommand::CONNECTED;
+            break;
+    }
+    return StompCommand::UNKNOWN;
+}
+
+StompHeader StompFrameParser::classifyHeader(const char* name, size_t length) {
+    switch (length) {
+        case 7:
+            if (name[0] == 'm' && sameName(name, "message", 7)) return StompHeader::MESSAGE;
+            if (name[0] == 'v' && sameName(name, "version", 7)) return StompHeader::VERSION;
+            break;
+        case 10:
+            if (name[0] == 'r' && sameName(name, "receipt-id", 10)) return StompHeader::RECEIPT_ID;
+            if (name[0] == 'm' && sameName(name, "message-id", 10)) return StompHeader::MESSAGE_ID;
+            break;
+        case 11:
+            if (sameName(name, "destination", 11)) return StompHeader::DESTINATION;
+            break;
+        case 12:
+            if (sameName(name, "subscription", 12)) return StompHeader::SUBSCRIPTION;
+            break;
+        case 14:
+            if (sameName(name, "content-length", 14)) return StompHeader::CONTENT_LENGTH;
+            break;
+    }
+    return StompHeader::UNKNOWN;
+}
+
+EventField StompFrameParser::classifyEventField(const char* name, size_t length) {
+    switch (length) {
+        case 4:
+            if (name[0] == 'u' && sameName(name, "user", 4)) return EventField::USER;
+            if (name[0] == 'c' && sameName(name, "city", 4)) return EventField::CITY;
+            break;
+        case 9:
+            if (sameName(name, "date time", 9)) return EventField::DATE_TIME;
+            break;
+        case 10:
+            if (sameName(name, "event name", 10)) return EventField::EVENT_NAME;
+            break;
+        case 11:
+            if (name[0] == 'd' && name[1] == 'e' && name[2] == 's') {
+                if (sameName(name, "description", 11)) return EventField::DESCRIPTION;
+                if (sameName(name, "destination", 11)) return EventField::DESTINATION;
+            }
+            break;
+        case 19:
+            if (sameName(name, "general information", 19)) return EventField::GENERAL_INFORMATION;
+            break;
+    }
+    return EventField::UNKNOWN;
+}
+
+// Record a header, the first occurrence of a repeated known header wins (STOMP 1.2)
+void StompFrameParser::addHeader(FrameView& frame, const StringSlice& name, const StringSlice& value) {
+    if (frame.numHeaders < FrameView::MAX_HEADERS) {
+        frame.headerNames[frame.numHeaders] = name;
+        frame.headerValues[frame.numHeaders] = value;
+        ++frame.numHeaders;
+    }
+    StompHeader header = classifyHeader(name.data, name.size);
+    if (header != StompHeader::UNKNOWN && !frame.hasHeader(header)) {
+        frame.knownHeaders[static_cast<int>(header)] = value;
+        frame.knownHeaderMask |= 1u << static_cast<int>(header);
+    }
+}
+
+bool StompFrameParser::parse(const char* data, size_t size, FrameView& frame) {
+    static thread_local StructuralIndex scratch;
+    scratch.clear();
+    scratch.scan(data, size, '\0');
+    return parse(data, size, scratch.data(), scratch.size(), 0, frame);
+}
+
+// Walks the marks of one line: from mark up to the line's newline mark (or markCount if the
+// line runs to the end), noting the line's first colon. Returns the offset the line ends at.
+static size_t scanLine(const char* data, size_t size, const uint32_t* marks, size_t markCount, uint32_t markBase,
+                       size_t& mark, const char*& colon) {
+    colon = nullptr;
+    for (; mark < markCount; ++mark) {
+        const char* p = data + (marks[mark] - markBase);
+        if (*p == '\n') {
+            return p - data;
+        }
+        if (*p == ':' && colon == nullptr) {
+            colon = p;
+        }
+    }
+    return size;
+}
+
+bool StompFrameParser::parse(const char* data, size_t size, const uint32_t* marks, size_t markCount,
+                             uint32_t markBase, FrameView& frame) {
+    frame.clear();
+    frame.raw = StringSlice(data, size);
+    frame.marks = marks;
+    frame.markCount = markCount;
+    frame.markBase = markBase;
+    frame.bodyMark = markCount;
+
+    // Skip heart-beat end-of-lines preceding the command
+    size_t start = 0;
+    while (start < size && (data[start] == '\n' || data[start] == '\r')) {
+        ++start;
+    }
+    if (start == size) {
+        return false;
+    }
+    size_t mark = 0;
+    while (mark < markCount && marks[mark] - markBase < start) {
+        ++mark;
+    }
+
+    const char* colon;
+    size_t lineEnd = scanLine(data, size, marks, markCount, markBase, mark, colon);
+    frame.command = lineSlice(data + start, data + lineEnd);
+    frame.commandType = classifyCommand(frame.command.data, frame.command.size);
+
+    // One header per line up to the blank line, lines without a colon are not headers
+    while (mark < markCount) {
+        ++mark; // Past the newline ending the previous line
+        size_t lineStart = lineEnd + 1;
+        lineEnd = scanLine(data, size, marks, markCount, markBase, mark, colon);
+        bool newline = mark < markCount;
+        if (newline && (lineEnd == lineStart || (lineEnd == lineStart + 1 && data[lineStart] == '\r'))) {
+            // Blank line - the rest of the frame is the body
+            frame.body = StringSlice(data + lineEnd + 1, size - lineEnd - 1);
+            frame.bodyMark = mark + 1;
+            break;
+        }
+        if (colon != nullptr) {
+            addHeader(frame, StringSlice(data + lineStart, colon - data - lineStart), lineSlice(colon + 1, data + lineEnd));
+        }
+    }
+    return true;
+}
+
+void StompFrameParser::parseEventReport(const FrameView& frame, EventReportView& report) {
+    bool inDescription = false;
+    bool inGeneralInfo = false;
+
+    report.channel = frame.header(StompHeader::DESTINATION);
+
+    // Lines and their first colon come from the marks the frame was parsed with
+    const char* data = frame.raw.data;
+    size_t size = frame.raw.size;
+    size_t mark = frame.bodyMark;
+    size_t next = frame.body.size > 0 ? frame.body.data - data : size;
+    while (next < size) {
+        const char* colon;
+        size_t lineEnd = scanLine(data, size, frame.marks, frame.markCount, frame.markBase, mark, colon);
+        StringSlice line(data + next, lineEnd - next);
+        next = lineEnd + 1;
+        ++mark;
+        size_t nameLength = colon ? colon - line.data : 0;
+        EventField field = colon ? classifyEventField(line.data, nameLength) : EventField::UNKNOWN;
+        StringSlice value = colon ? line.dropPrefix(nameLength + 1) : StringSlice();
+
+        switch (field) {
+            case EventField::DESTINATION:
+                report.channel = value;
+                break;
+            case EventField::USER:
+                report.user = value;
+                break;
+            case EventField::CITY:
+                report.city = value;
+                break;
+            case EventField::EVENT_NAME:
+                report.eventName = value;
+                break;
+            case EventField::DATE_TIME:
+                value.toInt(report.dateTime);
+                break;
+            case EventField::GENERAL_INFORMATION:
+                // Start parsing the general information block
+                inGeneralInfo = true;
+                break;
+            case EventField::DESCRIPTION:
+                // Start parsing the description block
+                report.description.assign(value.data, value.size);
+                inDescription = true;
+                inGeneralInfo = false; // End general info block
+                break;
+            case EventField::UNKNOWN:
+                if (inGeneralInfo) {
+                    // Indented "key: value" lines, anything else ends the block
+                    if (!colon) {
+                        inGeneralInfo = false;
+                    } else {
+                        report.generalInformation[StringSlice(line.data, nameLength).trim().str()] = value.trim().str();
+                    }
+                } else if (inDescription) {
+                    // Multi-line description, stops on encountering a new field
+                    if (line.empty() || colon) {
+                        inDescription = false;
+                    } else {
+                        report.description.append(line.data, line.size);
+                    }
+                }
+                break;
+        }
+    }
+}
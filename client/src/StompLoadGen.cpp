@@ -0,0 +1,265 @@
+#include "../include/SessionManager.h"
+#include "../include/event.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless load generator: K sessions subscribe to M channels and replay an events file
+// as SEND frames at a target rate, then report throughput, receipt latency and errors.
+//
+// Before sending it reports the process's resident memory per logged in session.
+//
+// Usage: StompLoadGen {host:port} [--connections K] [--channels M] [--rate frames/s]
+//                     [--duration seconds] [--file events.json] [--threads T]
+
+struct LoadGenOptions {
+    std::string host;
+    short port;
+    size_t connections;
+    size_t channels;
+    double rate;      // SEND frames per second over all connections
+    double duration;  // Seconds of sending
+    std::string file;
+    size_t threads;   // io threads
+
+    LoadGenOptions()
+        : host(), port(0), connections(10), channels(1), rate(1000), duration(10),
+          file("data/events1.json"), threads(2) {}
+};
+
+// Traffic counters, updated from the io threads
+struct LoadGenStats {
+    std::atomic<long> sent;
+    std::atomic<long> failedSends;
+    std::atomic<long> received;
+    std::atomic<long> messages;
+    std::atomic<long> receipts;
+    std::atomic<long> lostReceipts; // Overwritten in the ring before their RECEIPT arrived
+    std::atomic<long> errors;
+    std::atomic<long> failedConnections;
+    std::mutex latencyLock;
+    std::vector<long> latencies; // Receipt round trips in microseconds
+
+    LoadGenStats()
+        : sent(0), failedSends(0), received(0), messages(0), receipts(0), lostReceipts(0), errors(0),
+          failedConnections(0), latencyLock(), latencies() {}
+};
+
+static void printUsage() {
+    std::cout << "Usage: StompLoadGen {host:port} [--connections K] [--channels M] [--rate frames/s]"
+              << " [--duration seconds] [--file events.json] [--threads T]" << std::endl;
+}
+
+static bool parseOptions(int argc, char* argv[], LoadGenOptions& options) {
+    if (argc < 2) {
+        return false;
+    }
+    std::string hostPort = argv[1];
+    size_t colonPos = hostPort.find(':');
+    if (colonPos == std::string::npos) {
+        return false;
+    }
+    options.host = hostPort.substr(0, colonPos);
+    options.port = static_cast<short>(std::atoi(hostPort.c_str() + colonPos + 1));
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--connections") {
+            options.connections = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--channels") {
+            options.channels = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--rate") {
+            options.rate = std::atof(value.c_str());
+        } else if (flag == "--duration") {
+            options.duration = std::atof(value.c_str());
+        } else if (flag == "--file") {
+            options.file = value;
+        } else if (flag == "--threads") {
+            options.threads = std::strtoul(value.c_str(), nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return !options.host.empty() && options.port > 0 && options.connections > 0 && options.channels > 0 &&
+           options.rate > 0;
+}
+
+// Latency at quantile q of sorted samples
+static long percentile(const std::vector<long>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Resident set size of this process in KiB, 0 if it cannot be read
+static long residentKiB() {
+    std::ifstream statm("/proc/self/statm");
+    long size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static std::string channelName(const std::string& base, size_t channels, size_t index) {
+    return channels == 1 ? base : base + "-" + std::to_string(index);
+}
+
+int main(int argc, char* argv[]) {
+    LoadGenOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::unique_ptr<names_and_events> parsed;
+    try {
+        parsed.reset(new names_and_events(parseEventsFile(options.file)));
+    } catch (std::exception& e) {
+        std::cerr << "Cannot read " << options.file << ": " << e.what() << std::endl;
+        return 1;
+    }
+    const names_and_events& report = *parsed;
+    if (report.events.empty()) {
+        std::cerr << "No events in " << options.file << std::endl;
+        return 1;
+    }
+
+    LoadGenStats stats;
+    SessionManager manager(options.threads);
+    long residentBefore = residentKiB(); // The events and io threads, before any session
+
+    // Enough receipt slots for everything in flight at the target rate
+    size_t receiptCapacity = std::max(static_cast<size_t>(options.rate / options.connections), ReceiptTracker::DEFAULT_CAPACITY);
+
+    std::vector<std::shared_ptr<Session>> sessions;
+    for (size_t i = 0; i < options.connections; ++i) {
+        std::shared_ptr<Session> session = manager.createSession(nullptr, receiptCapacity);
+        session->setKeepEvents(false);
+        session->setFrameObserver([&stats](const FrameView& frame) {
+            ++stats.received;
+            if (frame.type() == StompCommand::MESSAGE) {
+                ++stats.messages;
+            } else if (frame.type() == StompCommand::ERROR) {
+                ++stats.errors;
+            }
+        });
+        session->setReceiptHandler([&stats](int, std::chrono::microseconds roundTrip) {
+            ++stats.receipts;
+            std::lock_guard<std::mutex> lock(stats.latencyLock);
+            stats.latencies.push_back(static_cast<long>(roundTrip.count()));
+        });
+        if (!session->connect(options.host, options.port) ||
+            !session->login("loadgen" + std::to_string(i), "loadgen")) {
+            ++stats.failedConnections;
+            manager.removeSession(session);
+            continue;
+        }
+        sessions.push_back(session);
+    }
+    if (sessions.empty()) {
+        std::cerr << "No connection could be made" << std::endl;
+        return 1;
+    }
+
+    // Wait for CONNECTED, then subscribe every session to every channel
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    for (const std::shared_ptr<Session>& session : sessions) {
+        while (!session->isLoggedIn() && session->isConnected() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for (size_t c = 0; c < options.channels; ++c) {
+            session->send(session->getProtocol().constructSubscribeFrame(
+                    channelName(report.channel_name, options.channels, c)));
+        }
+    }
+
+    long sessionKiB = residentKiB() - residentBefore;
+    std::cout << sessions.size() << " sessions logged in: " << sessionKiB << " KiB resident, "
+              << sessionKiB / static_cast<long>(sessions.size()) << " KiB per session" << std::endl;
+
+    std::cout << sessions.size() << " connections, " << options.channels << " channels, "
+              << report.events.size() << " events, " << options.rate << " frames/s for "
+              << options.duration << " s" << std::endl;
+
+    // Pace SEND frames round-robin over the sessions, catching up every millisecond
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point nextProgress = start + std::chrono::seconds(1);
+    long scheduled = 0;
+    long lastSent = 0, lastReceived = 0;
+    while (true) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        if (elapsed >= options.duration) {
+            break;
+        }
+        long due = static_cast<long>(elapsed * options.rate);
+        for (; scheduled < due; ++scheduled) {
+            Session& session = *sessions[scheduled % sessions.size()];
+            const Event& event = report.events[(scheduled / sessions.size()) % report.events.size()];
+            std::string channel = channelName(report.channel_name, options.channels, scheduled % options.channels);
+
+            // The frame's receipt header makes the server acknowledge the SEND, giving its round trip
+            int receiptId;
+            std::string frame = session.getProtocol().constructReportFrame(channel, session.getUser(), event, &receiptId);
+            if (!session.getProtocol().receiptTracker.registerReceipt(receiptId, std::string())) {
+                ++stats.lostReceipts;
+            }
+
+            session.send(std::move(frame), [&stats](bool ok) {
+                if (ok) {
+                    ++stats.sent;
+                } else {
+                    ++stats.failedSends;
+                }
+            });
+        }
+        if (now >= nextProgress) {
+            long sent = stats.sent.load(), received = stats.received.load();
+            std::cout << "sent " << sent - lastSent << "/s, received " << received - lastReceived << "/s" << std::endl;
+            lastSent = sent;
+            lastReceived = received;
+            nextProgress += std::chrono::seconds(1);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Rates are over the sending period, late receipts and messages still count
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Give the last receipts a moment to arrive, then log out
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for (const std::shared_ptr<Session>& session : sessions) {
+        session->send(session->getProtocol().constructDisconnectFrame());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    manager.stop();
+
+    std::vector<long> latencies;
+    {
+        std::lock_guard<std::mutex> lock(stats.latencyLock);
+        latencies.swap(stats.latencies);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "sent " << stats.sent.load() << " frames (" << stats.sent.load() / elapsed << "/s), received "
+              << stats.received.load() << " frames (" << stats.received.load() / elapsed << "/s, "
+              << stats.messages.load() << " MESSAGE)" << std::endl
+              << "receipts " << stats.receipts.load() << " (" << stats.lostReceipts.load()
+              << " lost to a full ring): p50 " << percentile(latencies, 0.5) << " us, p99 "
+              << percentile(latencies, 0.99) << " us, p999 " << percentile(latencies, 0.999) << " us" << std::endl
+              << "errors: " << stats.errors.load() << " ERROR frames, " << stats.failedSends.load()
+              << " failed sends, " << stats.failedConnections.load() << " failed connections" << std::endl;
+    return 0;
+}
@@ -0,0 +1,266 @@
+#include "../include/ConcurrentMap.h"
+#include "../include/SharedMutex.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Concurrent map benchmark: the same operation streams run against the previous
+// mutex + std::map class and against ConcurrentMap with std::mutex and SharedMutex
+// shard locks, single threaded and on every core.
+//
+// Usage: StompMapBench [operations per thread in millions] [keys] [threads, default every core]
+
+// The channel map as it was before ConcurrentMap: one mutex over a std::map
+namespace previous {
+
+class ConcurrentHashMap {
+private:
+    std::map<std::string, int> map; // The underlying map
+    mutable std::mutex mapMutex;    // Mutex for thread safety
+
+public:
+    ConcurrentHashMap() : map(), mapMutex() {}
+
+    // Inserts or updates a key-value pair
+    void insertOrUpdate(const std::string& key, int value) {
+        std::lock_guard<std::mutex> lock(mapMutex);
+        map[key] = value;
+    }
+
+    // Retrieves the value associated with a key
+    // Returns true if the key exists, false otherwise
+    bool get(const std::string& key, int& value) const {
+        std::lock_guard<std::mutex> lock(mapMutex);
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    // Removes a key
+    bool remove(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mapMutex);
+        return map.erase(key) > 0;
+    }
+
+    // Checks if a key exists
+    bool contains(const std::string& key) const {
+        std::lock_guard<std::mutex> lock(mapMutex);
+        return map.find(key) != map.end();
+    }
+};
+
+} // namespace previous
+
+enum Operation : unsigned char { LOOKUP, INCREMENT, UPDATE_IF_PRESENT, INSERT_IF_ABSENT, REMOVE };
+
+// What one call of each operation does, for the previous class as a caller had to write it
+// out of its primitives (a lookup and a write under separate locks), and for ConcurrentMap
+// as one call under one shard lock
+struct PreviousMap {
+    previous::ConcurrentHashMap map;
+
+    PreviousMap() : map() {}
+
+    int apply(Operation operation, const std::string& key) {
+        int value = 0;
+        switch (operation) {
+        case LOOKUP:
+            return map.get(key, value) ? value : 0;
+        case INCREMENT:
+            map.get(key, value);
+            map.insertOrUpdate(key, value + 1);
+            return 0;
+        case UPDATE_IF_PRESENT:
+            if (map.get(key, value)) {
+                map.insertOrUpdate(key, value + 1);
+            }
+            return 0;
+        case INSERT_IF_ABSENT:
+            if (!map.contains(key)) {
+                map.insertOrUpdate(key, 1);
+            }
+            return 0;
+        case REMOVE:
+            map.remove(key);
+            return 0;
+        }
+        return 0;
+    }
+};
+
+template <typename Mutex>
+struct ShardedMap {
+    StringConcurrentMap<int, Mutex> map;
+
+    ShardedMap() : map() {}
+
+    int apply(Operation operation, const std::string& key) {
+        int value = 0;
+        switch (operation) {
+        case LOOKUP:
+            map.visit(key, [&value](const int& current) { value = current; });
+            return value;
+        case INCREMENT:
+            map.compute(key, [](int& current) { ++current; });
+            return 0;
+        case UPDATE_IF_PRESENT:
+            map.updateIf(key, [](int& current) { ++current; });
+            return 0;
+        case INSERT_IF_ABSENT:
+            map.tryEmplace(key, 1);
+            return 0;
+        case REMOVE:
+            map.remove(key);
+            return 0;
+        }
+        return 0;
+    }
+};
+
+// Share of each operation in a workload, in percent, the rest are lookups
+struct Workload {
+    const char* name;
+    int increment;
+    int updateIfPresent;
+    int insertIfAbsent;
+    int remove;
+};
+
+// Join/exit churn and receipt counters on top of a stream of per-frame lookups
+static const Workload WORKLOADS[] = {
+    {"read-mostly", 1, 1, 1, 1},
+    {"write-heavy", 20, 20, 15, 15},
+};
+
+// A reproducible stream of operations on random keys, different for each thread
+static void buildStream(const Workload& workload, size_t operations, size_t keys, uint64_t seed,
+                        std::vector<Operation>& kinds, std::vector<uint32_t>& keyIndexes) {
+    kinds.resize(operations);
+    keyIndexes.resize(operations);
+    uint64_t state = seed * 0x9e3779b97f4a7c15ULL + 1;
+    for (size_t i = 0; i < operations; ++i) {
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int percent = static_cast<int>(state % 100);
+        Operation kind = LOOKUP;
+        if ((percent -= workload.increment) < 0) {
+            kind = INCREMENT;
+        } else if ((percent -= workload.updateIfPresent) < 0) {
+            kind = UPDATE_IF_PRESENT;
+        } else if ((percent -= workload.insertIfAbsent) < 0) {
+            kind = INSERT_IF_ABSENT;
+        } else if ((percent -= workload.remove) < 0) {
+            kind = REMOVE;
+        }
+        kinds[i] = kind;
+        keyIndexes[i] = static_cast<uint32_t>((state >> 32) % keys);
+    }
+}
+
+// Run every thread's stream against a fresh map, returning the seconds taken and the sum of
+// what the lookups saw and of the final values, which single threaded runs must agree on
+template <typename Map>
+static double run(const std::vector<std::string>& keys, const std::vector<std::vector<Operation>>& kinds,
+                  const std::vector<std::vector<uint32_t>>& keyIndexes, long& checksum) {
+    Map map;
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        map.apply(INSERT_IF_ABSENT, keys[i]);
+    }
+
+    std::atomic<bool> go(false);
+    std::atomic<long> sum(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kinds.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            long seen = 0;
+            const std::vector<Operation>& ops = kinds[t];
+            const std::vector<uint32_t>& indexes = keyIndexes[t];
+            for (size_t i = 0; i < ops.size(); ++i) {
+                seen += map.apply(ops[i], keys[indexes[i]]);
+            }
+            sum += seen;
+        });
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    go = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    checksum = sum.load();
+    for (const std::string& key : keys) {
+        checksum += map.apply(LOOKUP, key);
+    }
+    return seconds;
+}
+
+static void report(const char* name, size_t operations, double seconds) {
+    std::cout << std::setw(14) << std::fixed << std::setprecision(1) << operations / seconds / 1e6 << " Mops/s  "
+              << name << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t millions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2;
+    size_t keyCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+    size_t perThread = std::max(millions, static_cast<size_t>(1)) * 1000000;
+    keyCount = std::max(keyCount, static_cast<size_t>(1));
+
+    // Keys shaped like channel names
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < keyCount; ++i) {
+        keys.push_back("/emergency/channel-" + std::to_string(i));
+    }
+
+    size_t cores = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : std::thread::hardware_concurrency();
+    std::vector<size_t> threadCounts(1, 1);
+    if (cores > 1) {
+        threadCounts.push_back(cores);
+    }
+
+    long sink = 0;
+    for (const Workload& workload : WORKLOADS) {
+        for (size_t threadCount : threadCounts) {
+            std::vector<std::vector<Operation>> kinds(threadCount);
+            std::vector<std::vector<uint32_t>> keyIndexes(threadCount);
+            for (size_t t = 0; t < threadCount; ++t) {
+                buildStream(workload, perThread, keyCount, t + 1, kinds[t], keyIndexes[t]);
+            }
+            size_t operations = perThread * threadCount;
+            std::cout << workload.name << ", " << threadCount << (threadCount == 1 ? " thread, " : " threads, ")
+                      << keyCount << " keys" << std::endl;
+
+            long previousSum, mutexSum, sharedSum;
+            report("mutex + std::map", operations, run<PreviousMap>(keys, kinds, keyIndexes, previousSum));
+            report("ConcurrentMap<std::mutex>", operations,
+                   run<ShardedMap<std::mutex>>(keys, kinds, keyIndexes, mutexSum));
+            report("ConcurrentMap<SharedMutex>", operations,
+                   run<ShardedMap<SharedMutex>>(keys, kinds, keyIndexes, sharedSum));
+
+            // With one thread every map sees the same operations in the same order
+            if (threadCount == 1 && (mutexSum != previousSum || sharedSum != previousSum)) {
+                std::cerr << "ConcurrentMap disagrees with the previous map" << std::endl;
+                return 1;
+            }
+            sink += previousSum + mutexSum + sharedSum;
+        }
+    }
+    return sink == 0; // Keeps the work from being optimized away
+}
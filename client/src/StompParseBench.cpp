@@ -0,0 +1,355 @@
+#include "../include/StompFrameParser.h"
+#include "../include/StructuralIndex.h"
+#include "../include/FrameWriter.h"
+#include "../include/event.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Frame splitting and parsing benchmark: MESSAGE frames built from an events file are
+// split and parsed the way the receive path does, once with the previous byte-at-a-time
+// parser and once per structural scan kernel the CPU supports.
+//
+// Usage: StompParseBench [events.json] [megabytes of frames]
+
+// Bytes handed to the splitter per read, like ConnectionHandler::RECV_BUFFER_SIZE
+static const size_t READ_SIZE = 1 << 16;
+
+// Parsed fields compared between the two parsers
+struct ParsedFrame {
+    StringSlice command;
+    StringSlice destination;
+    StringSlice body;
+    size_t headers;
+
+    ParsedFrame() : command(), destination(), body(), headers(0) {}
+};
+
+// The parser as it was before the structural index: a state machine over every byte,
+// and memchr for each line and colon of the event report.
+namespace previous {
+
+static StringSlice lineSlice(const char* begin, const char* end) {
+    if (end > begin && end[-1] == '\r') {
+        --end;
+    }
+    return StringSlice(begin, end - begin);
+}
+
+static void addHeader(ParsedFrame& frame, const StringSlice& name, const StringSlice& value) {
+    ++frame.headers;
+    if (frame.destination.data == nullptr && name.equals("destination")) {
+        frame.destination = value;
+    }
+}
+
+static bool parse(const char* data, size_t size, ParsedFrame& frame) {
+    enum State { COMMAND_START, COMMAND, HEADER_START, HEADER_NAME, HEADER_VALUE, BODY };
+
+    frame = ParsedFrame();
+    State state = COMMAND_START;
+    const char* tokenStart = data;
+    const char* colon = data;
+    const char* end = data + size;
+
+    for (const char* p = data; p < end && state != BODY; ++p) {
+        char c = *p;
+        switch (state) {
+            case COMMAND_START:
+                if (c != '\n' && c != '\r') {
+                    tokenStart = p;
+                    state = COMMAND;
+                }
+                break;
+            case COMMAND:
+                if (c == '\n') {
+                    frame.command = lineSlice(tokenStart, p);
+                    state = HEADER_START;
+                }
+                break;
+            case HEADER_START:
+                if (c == '\n') {
+                    frame.body = StringSlice(p + 1, end - p - 1);
+                    state = BODY;
+                } else if (c == '\r' && p + 1 < end && p[1] == '\n') {
+                } else if (c == ':') {
+                    tokenStart = colon = p;
+                    state = HEADER_VALUE;
+                } else {
+                    tokenStart = p;
+                    state = HEADER_NAME;
+                }
+                break;
+            case HEADER_NAME:
+                if (c == ':') {
+                    colon = p;
+                    state = HEADER_VALUE;
+                } else if (c == '\n') {
+                    state = HEADER_START;
+                }
+                break;
+            case HEADER_VALUE:
+                if (c == '\n') {
+                    addHeader(frame, StringSlice(tokenStart, colon - tokenStart), lineSlice(colon + 1, p));
+                    state = HEADER_START;
+                }
+                break;
+            case BODY:
+                break;
+        }
+    }
+
+    if (state == COMMAND) {
+        frame.command = lineSlice(tokenStart, end);
+    } else if (state == HEADER_VALUE) {
+        addHeader(frame, StringSlice(tokenStart, colon - tokenStart), lineSlice(colon + 1, end));
+    }
+    return state != COMMAND_START;
+}
+
+static void parseEventReport(const ParsedFrame& frame, EventReportView& report) {
+    bool inDescription = false;
+    bool inGeneralInfo = false;
+
+    report.channel = frame.destination;
+
+    const char* end = frame.body.data + frame.body.size;
+    const char* next = frame.body.data;
+    while (next < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(next, '\n', end - next));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        StringSlice line(next, lineEnd - next);
+        next = lineEnd + 1;
+
+        const char* colon = static_cast<const char*>(std::memchr(line.data, ':', line.size));
+        size_t nameLength = colon ? colon - line.data : 0;
+        EventField field = colon ? StompFrameParser::classifyEventField(line.data, nameLength) : EventField::UNKNOWN;
+        StringSlice value = colon ? line.dropPrefix(nameLength + 1) : StringSlice();
+
+        switch (field) {
+            case EventField::DESTINATION:
+                report.channel = value;
+                break;
+            case EventField::USER:
+                report.user = value;
+                break;
+            case EventField::CITY:
+                report.city = value;
+                break;
+            case EventField::EVENT_NAME:
+                report.eventName = value;
+                break;
+            case EventField::DATE_TIME:
+                value.toInt(report.dateTime);
+                break;
+            case EventField::GENERAL_INFORMATION:
+                inGeneralInfo = true;
+                break;
+            case EventField::DESCRIPTION:
+                report.description.assign(value.data, value.size);
+                inDescription = true;
+                inGeneralInfo = false;
+                break;
+            case EventField::UNKNOWN:
+                if (inGeneralInfo) {
+                    if (!colon) {
+                        inGeneralInfo = false;
+                    } else {
+                        report.generalInformation[StringSlice(line.data, nameLength).trim().str()] = value.trim().str();
+                    }
+                } else if (inDescription) {
+                    if (line.empty() || colon) {
+                        inDescription = false;
+                    } else {
+                        report.description.append(line.data, line.size);
+                    }
+                }
+                break;
+        }
+    }
+}
+
+} // namespace previous
+
+// MESSAGE frames as the server forwards reports, back to back with their null delimiters
+static std::string buildStream(const names_and_events& events, size_t targetBytes, size_t& frames) {
+    FrameWriter writer(targetBytes + READ_SIZE);
+    long messageId = 0;
+    frames = 0;
+    while (writer.size() < targetBytes) {
+        for (const Event& event : events.events) {
+            writer.command("MESSAGE")
+                  .header("subscription", 0L)
+                  .header("message-id", messageId++)
+                  .header("destination", events.channel_name)
+                  .endHeaders()
+                  .header("user", std::string("bench"))
+                  .header("city", event.get_city())
+                  .header("event name", event.get_name())
+                  .header("date time", static_cast<long>(event.get_date_time()))
+                  .append("general information:\n");
+            event.for_each_general_information([&writer](const std::string& key, const std::string& value) {
+                writer.append(' ').append(key).append(": ").append(value).append('\n');
+            });
+            writer.append("description:\n").append(event.get_description()).append("\n\n");
+            writer.endFrame();
+            ++frames;
+        }
+    }
+    return std::string(writer.data(), writer.size());
+}
+
+static bool sameReport(const EventReportView& a, const EventReportView& b) {
+    return a.channel.str() == b.channel.str() && a.user.str() == b.user.str() && a.city.str() == b.city.str() &&
+           a.eventName.str() == b.eventName.str() && a.dateTime == b.dateTime && a.description == b.description &&
+           a.generalInformation == b.generalInformation;
+}
+
+// Split and parse the stream with the previous parser, calling check on every frame
+template <typename Check>
+static size_t runPrevious(const std::string& stream, bool reports, Check check) {
+    size_t frames = 0;
+    const char* next = stream.data();
+    const char* end = next + stream.size();
+    ParsedFrame frame;
+    while (next < end) {
+        const char* delimiter = static_cast<const char*>(std::memchr(next, '\0', end - next));
+        previous::parse(next, delimiter - next, frame);
+        if (reports) {
+            EventReportView report;
+            previous::parseEventReport(frame, report);
+            check(frame, report);
+        }
+        ++frames;
+        next = delimiter + 1;
+    }
+    return frames;
+}
+
+// Split and parse the stream the way ConnectionHandler::handleRead does, a read at a time
+template <typename Check>
+static size_t runIndexed(const std::string& stream, bool reports, Check check) {
+    size_t frames = 0;
+    StructuralIndex index;
+    FrameView frame;
+    size_t frameStart = 0;
+    for (size_t readStart = 0; readStart < stream.size(); readStart += READ_SIZE) {
+        size_t readSize = std::min(READ_SIZE, stream.size() - readStart);
+        index.scan(stream.data() + readStart, readSize, '\0', static_cast<uint32_t>(readStart));
+        size_t frameMark = 0;
+        for (size_t mark = 0; mark < index.size(); ++mark) {
+            size_t delimiterAt = index[mark];
+            if (stream[delimiterAt] != '\0') {
+                continue;
+            }
+            StompFrameParser::parse(stream.data() + frameStart, delimiterAt - frameStart, index.data() + frameMark,
+                                    mark - frameMark, static_cast<uint32_t>(frameStart), frame);
+            if (reports) {
+                EventReportView report;
+                StompFrameParser::parseEventReport(frame, report);
+                check(frame, report);
+            }
+            ++frames;
+            frameStart = delimiterAt + 1;
+            frameMark = mark + 1;
+        }
+        index.dropFront(frameMark);
+    }
+    return frames;
+}
+
+// Best time of a few runs, in seconds
+template <typename Run>
+static double bestOf(Run run) {
+    double best = 1e9;
+    for (int i = 0; i < 5; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+static void report(const char* name, size_t bytes, size_t frames, double headersSeconds, double reportsSeconds) {
+    double megabytes = bytes / (1024.0 * 1024.0);
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << megabytes / headersSeconds << " MB/s " << std::setw(12) << frames / headersSeconds
+              << " frames/s    " << std::setw(10) << megabytes / reportsSeconds << " MB/s " << std::setw(12)
+              << frames / reportsSeconds << " frames/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string file = argc > 1 ? argv[1] : "data/events1.json";
+    size_t megabytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 32;
+
+    std::unique_ptr<names_and_events> events;
+    try {
+        events.reset(new names_and_events(parseEventsFile(file)));
+    } catch (std::exception& e) {
+        std::cerr << "Cannot read " << file << ": " << e.what() << std::endl;
+        return 1;
+    }
+    if (events->events.empty()) {
+        std::cerr << "No events in " << file << std::endl;
+        return 1;
+    }
+
+    size_t frames;
+    std::string stream = buildStream(*events, megabytes << 20, frames);
+    std::cout << frames << " MESSAGE frames, " << stream.size() << " bytes" << std::endl;
+
+    // Every kernel must agree with the previous parser before it is timed
+    std::vector<ParsedFrame> expectedFrames;
+    std::vector<EventReportView> expectedReports;
+    runPrevious(stream, true, [&](const ParsedFrame& frame, EventReportView& parsed) {
+        expectedFrames.push_back(frame);
+        expectedReports.push_back(std::move(parsed));
+    });
+
+    std::cout << std::left << std::setw(10) << "parser" << std::right << std::setw(40) << "split + headers"
+              << std::setw(42) << "split + headers + event report" << std::endl;
+
+    size_t sink = 0;
+    double headers = bestOf([&]() { sink += runPrevious(stream, false, [](const ParsedFrame&, EventReportView&) {}); });
+    double reports = bestOf([&]() {
+        sink += runPrevious(stream, true, [&](const ParsedFrame&, EventReportView& r) { sink += r.dateTime; });
+    });
+    report("previous", stream.size(), frames, headers, reports);
+
+    const StructuralIndex::Kernel kernels[] = {StructuralIndex::SCALAR, StructuralIndex::SSE2, StructuralIndex::AVX2};
+    for (StructuralIndex::Kernel kernel : kernels) {
+        if (!StructuralIndex::selectKernel(kernel)) {
+            continue;
+        }
+        size_t checked = 0;
+        bool same = true;
+        runIndexed(stream, true, [&](const FrameView& frame, EventReportView& parsed) {
+            const ParsedFrame& expected = expectedFrames[checked];
+            same = same && frame.command.str() == expected.command.str() &&
+                   frame.headerCount() == expected.headers && frame.body.size == expected.body.size &&
+                   frame.header(StompHeader::DESTINATION).str() == expected.destination.str() &&
+                   sameReport(parsed, expectedReports[checked]);
+            ++checked;
+        });
+        if (!same || checked != frames) {
+            std::cerr << StructuralIndex::kernelName() << " disagrees with the previous parser" << std::endl;
+            return 1;
+        }
+
+        headers = bestOf([&]() { sink += runIndexed(stream, false, [](const FrameView&, EventReportView&) {}); });
+        reports = bestOf([&]() {
+            sink += runIndexed(stream, true, [&](const FrameView&, EventReportView& r) { sink += r.dateTime; });
+        });
+        report(StructuralIndex::kernelName(), stream.size(), frames, headers, reports);
+    }
+    StructuralIndex::selectKernel(StructuralIndex::AUTO);
+    return sink == 0; // Keeps the work from being optimized away
+}
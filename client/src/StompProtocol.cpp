@@ -1,17 +1,21 @@
 #include "../include/StompProtocol.h"
+#include "../include/EventSorter.h"
 #include <iostream>
-#include <sstream>
 #include <algorithm>
+#include <cstring>
 using namespace std;
 
-StompProtocol::StompProtocol()
+// Reserved for the short control frames, enough that building one allocates once
+static const size_t CONTROL_FRAME_CAPACITY = 128;
+
+StompProtocol::StompProtocol(size_t receiptCapacity)
     : receiptCounter(0),
       subscriptionCounter(0),
       isLogicConnected(false),
       sentDisconnect(-1),
       channelToSubcriptonID(),
-      summaryManager(),
-      receiptIDToMessageMap()
+      receiptTracker(receiptCapacity),
+      summaryManager()
 {}
 
 SummaryManager& StompProtocol::getSummaryManager() {
@@ -28,8 +32,14 @@ int StompProtocol::getNextSubscriptionId() {
 }
 
 std::string StompProtocol::constructConnectFrame(const std::string& username, const std::string& password) {
-    return "CONNECT\naccept-version:1.2\nhost:stomp.cs.bgu.ac.il\nlogin:" + username +
-           "\npasscode:" + password + "\n\n";
+    FrameWriter frame(CONTROL_FRAME_CAPACITY);
+    frame.command("CONNECT")
+         .header("accept-version", "1.2")
+         .header("host", "stomp.cs.bgu.ac.il")
+         .header("login", username)
+         .header("passcode", password)
+         .endHeaders();
+    return frame.takeFrame();
 }
 
 std::string StompProtocol::constructSubscribeFrame(const std::string& channel) {
@@ -39,80 +49,120 @@ std::string StompProtocol::constructSubscribeFrame(const std::string& channel) {
     //update map
     channelToSubcriptonID.insertOrUpdate(channel, subscriptionId);
 
-    receiptIDToMessageMap.insertOrUpdate(receiptId, "Joined channel "+channel);
+    receiptTracker.registerReceipt(receiptId, "Joined channel "+channel);
 
-    return "SUBSCRIBE\ndestination:" + channel + "\nid:" + std::to_string(subscriptionId) +
-           "\nreceipt:" + std::to_string(receiptId) + "\n\n";
+    FrameWriter frame(CONTROL_FRAME_CAPACITY);
+    frame.command("SUBSCRIBE")
+         .header("destination", channel)
+         .header("id", subscriptionId)
+         .header("receipt", receiptId)
+         .endHeaders();
+    return frame.takeFrame();
 }
 
 std::string StompProtocol::constructUnsubscribeFrame(const std::string& channel) {
     int receiptId = getNextReceiptId();
     int subID;
-    if(!channelToSubcriptonID.contains(channel)){
+    //get relevant id and delete it in one step
+    if(!channelToSubcriptonID.takeIfPresent(channel, subID)){
         subID = -1;
     }
-    else{
-        //get relevant id
-        subID = channelToSubcriptonID.getValue(channel);
-        //delete it
-        channelToSubcriptonID.remove(channel);
-    }
     
-    receiptIDToMessageMap.insertOrUpdate(receiptId, "Exited channel "+channel);
-
-    return "UNSUBSCRIBE\nid:"+std::to_string(subID)+"\nreceipt:" + std::to_string(receiptId) + "\n\n";
+    receiptTracker.registerReceipt(receiptId, "Exited channel "+channel);
+
+    FrameWriter frame(CONTROL_FRAME_CAPACITY);
+    frame.command("UNSUBSCRIBE")
+         .header("id", subID)
+         .header("receipt", receiptId)
+         .endHeaders();
+    return frame.takeFrame();
 }
 
 std::string StompProtocol::constructDisconnectFrame() {
     int receiptId = getNextReceiptId();
     sentDisconnect.store(receiptId);
-    return "DISCONNECT\nreceipt:" + std::to_string(receiptId) + "\n\n";
+    FrameWriter frame(CONTROL_FRAME_CAPACITY);
+    frame.command("DISCONNECT")
+         .header("receipt", receiptId)
+         .endHeaders();
+    return frame.takeFrame();
 }
 
 std::vector<std::string> StompProtocol::constructReportFrames(const std::string& filePath, const std::string& userNameOK) {
-    // Parse the events from the file
-    names_and_events parsedEvents = parseEventsFile(filePath);
-
-    // Sort events by date_time using a defined comparator
-    struct {
-        bool operator()(const Event& a, const Event& b) const {
-            return a.get_date_time() < b.get_date_time();
+    std::vector<std::string> frames;
+    streamReportFrames(filePath, userNameOK, 64, [&frames](const FrameWriter& batch) {
+        // Split the batch at the terminators
+        const char* begin = batch.data();
+        const char* end = begin + batch.size();
+        while (begin < end) {
+            size_t length = std::strlen(begin);
+            frames.emplace_back(begin, length);
+            begin += length + 1;
         }
-    } compareByDateTime; // Inline-defined comparator
-
-    std::sort(parsedEvents.events.begin(), parsedEvents.events.end(), compareByDateTime);
+        return true;
+    });
+    return frames;
+}
 
-    // Build the frames
-    std::vector<std::string> frames;
-    for (Event& event : parsedEvents.events) {
-        int receiptId = getNextReceiptId(); // Ensure receipt IDs are unique
-        summaryManager.addEvent(parsedEvents.channel_name, userNameOK, event); // Add event to SummaryManager
-        
-        // Frame construction
-        std::ostringstream frame;
-        frame << "SEND\n"
-              << "destination:" << parsedEvents.channel_name << "\n" 
-              << "user:" << userNameOK << "\n"
-              << "city:" << event.get_city() << "\n"
-              << "event name:" << event.get_name() << "\n"
-              << "date time:" << event.get_date_time() << "\n"
-              << "general information:\n";
-
-        for (const auto& pair : event.get_general_information()) {
-            frame << " " << pair.first << ": " << pair.second << "\n";
+bool StompProtocol::streamReportFrames(const std::string& filePath, const std::string& userNameOK,
+                                       size_t batchSize, const FrameSink& sink, parse_stats* stats) {
+    // Events go into the sorter as they are parsed, it holds at most a run of them in memory
+    EventSorter sorter;
+    std::string channel = parseEventsFileStreaming(filePath, [&sorter](Event& event) { sorter.add(event); }, stats);
+
+    // Build the frames a batch at a time into one buffer, emptied after each flush.
+    // Every event reaches the summary even once a send failed, only the sending stops.
+    FrameWriter batch;
+    bool sending = true;
+    sorter.finish(channel, [&](Event& event) {
+        if (sending) {
+            writeReportFrame(batch, channel, userNameOK, event);
+            if (batch.frameCount() >= batchSize) {
+                sending = sink(batch);
+                batch.clear();
+            }
         }
+        // Handed over last, the sorter's copy is freed as soon as it is stored
+        summaryManager.addEvent(channel, userNameOK, std::move(event));
+        return true;
+    });
 
-        // Add description, truncating if necessary
-        std::string description = event.get_description();
-        frame << "description:\n" << description << "\n";
+    return sending && (batch.empty() || sink(batch));
+}
 
-        // Add receipt
-        frame << "receipt:" << receiptId << "\n";
+std::string StompProtocol::constructReportFrame(const std::string& channel, const std::string& userNameOK, const Event& event,
+                                                int* receiptId) {
+    FrameWriter writer;
+    writeReportFrame(writer, channel, userNameOK, event, receiptId);
+    std::string frame = writer.takeFrame();
+    frame.pop_back(); // The string based send calls add the terminator
+    return frame;
+}
 
-        // Add the frame to the vector
-        frames.push_back(frame.str());
+void StompProtocol::writeReportFrame(FrameWriter& frame, const std::string& channel, const std::string& userNameOK,
+                                     const Event& event, int* receiptIdOut) {
+    int receiptId = getNextReceiptId(); // Ensure receipt IDs are unique
+    if (receiptIdOut) {
+        *receiptIdOut = receiptId;
     }
 
-    return frames;
+    // Frame construction
+    frame.command("SEND")
+         .header("destination", channel)
+         .header("user", userNameOK)
+         .header("city", event.get_city())
+         .header("event name", event.get_name())
+         .header("date time", event.get_date_time())
+         .append("general information:\n");
+
+    event.for_each_general_information([&frame](const std::string& key, const std::string& value) {
+        frame.append(' ').append(key).append(": ").append(value).append('\n');
+    });
+
+    // Add description
+    frame.append("description:\n").append(event.get_description()).append('\n');
+
+    // Add receipt
+    frame.header("receipt", receiptId);
+    frame.endFrame();
 }
-
@@ -0,0 +1,215 @@
+#include "../include/SummaryManager.h"
+#include "../include/event.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Restart check: a client stores events, logs users out and takes a snapshot, which rolls the
+// journal over, then a restarted client restores from the snapshot and the journal after it and
+// must hold exactly what the first client held when it stopped. The journal alone no longer
+// holds the events the snapshot covers and must be refused. Run once with the snapshot taken
+// before the logout and once with it taken after.
+// Then a journal that lost the bytes before the snapshot's offset, as unsynced writes do at a
+// power loss, must restore to the snapshot alone without replaying anything twice, and events
+// added after that must survive the next restart.
+//
+// Usage: StompRestartCheck [directory for the temporary files]
+
+static const char* CHANNELS[] = {"police", "fire_dept"};
+static const char* USERS[] = {"alice", "bob", "carol"};
+static const char* CITIES[] = {"Springfield", "Shelbyville", "Ogdenville"};
+
+// One event of user on channel, different for every step
+static void report(SummaryManager& summaries, const std::string& channel, const std::string& user, int step) {
+    std::map<std::string, std::string> general;
+    general["active"] = step % 2 == 0 ? "true" : "false";
+    general["forces_arrival_at_scene"] = step % 3 == 0 ? "true" : "false";
+    Event event(channel, CITIES[step % 3], "event " + std::to_string(step % 7), 1700000000 + step * 60 - step % 4 * 60,
+                user + " reports step " + std::to_string(step), general);
+    summaries.addEvent(channel, user, event);
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// Everything a user of the client can see: every channel's events and every user's summary
+static std::string describe(SummaryManager& summaries, const std::string& directory) {
+    std::ostringstream out;
+    std::string summaryPath = directory + "/summary.txt";
+    for (const char* channel : CHANNELS) {
+        std::vector<EventRecord> records = summaries.eventsBetween(channel, INT_MIN, INT_MAX);
+        // Equal times may come back in another order, which no query promises anyway
+        std::sort(records.begin(), records.end(), [](const EventRecord& a, const EventRecord& b) {
+            return std::tie(a.dateTime, *a.user, *a.name, a.description) <
+                   std::tie(b.dateTime, *b.user, *b.name, b.description);
+        });
+        out << channel << ": " << records.size() << " events\n";
+        for (const EventRecord& record : records) {
+            out << record.dateTime << ' ' << *record.user << ' ' << *record.city << ' ' << *record.name << ' '
+                << record.description << '\n';
+        }
+        for (const char* user : USERS) {
+            if (std::none_of(records.begin(), records.end(),
+                             [user](const EventRecord& record) { return *record.user == user; })) {
+                continue; // Logged out, nothing to summarize
+            }
+            std::remove(summaryPath.c_str());
+            summaries.generateSummary(channel, user, summaryPath);
+            out << readFile(summaryPath);
+        }
+    }
+    std::remove(summaryPath.c_str());
+    return out.str();
+}
+
+// Store events, log alice and bob out and store more, with the snapshot taken before or
+// after the logout. Returns what the client held when it stopped.
+static std::string run(const std::string& journal, const std::string& snapshot, bool snapshotAfterLogout,
+                       const std::string& directory) {
+    SummaryManager summaries;
+    if (!summaries.openJournal(journal, EventJournal::NO_SYNC)) {
+        return std::string();
+    }
+    int step = 0;
+    for (; step < 300; ++step) {
+        report(summaries, CHANNELS[step % 2], USERS[step % 3], step);
+    }
+    if (!snapshotAfterLogout && !(summaries.writeSnapshot(snapshot) && summaries.waitForSnapshot())) {
+        return std::string();
+    }
+    summaries.clearClientData("alice");
+    summaries.clearClientData("bob");
+    // alice logs back in, bob stays away
+    for (; step < 400; ++step) {
+        report(summaries, CHANNELS[step % 2], step % 2 == 0 ? "alice" : "carol", step);
+    }
+    if (snapshotAfterLogout && !(summaries.writeSnapshot(snapshot) && summaries.waitForSnapshot())) {
+        return std::string();
+    }
+    for (; step < 450; ++step) {
+        report(summaries, CHANNELS[step % 2], USERS[step % 3], step);
+    }
+    summaries.clearClientData("carol");
+    return describe(summaries, directory);
+}
+
+static bool check(const std::string& directory, bool snapshotAfterLogout) {
+    std::string journal = directory + "/events.jrn";
+    std::string snapshot = directory + "/events.snap";
+    std::remove(journal.c_str());
+    std::remove(snapshot.c_str());
+
+    std::string expected = run(journal, snapshot, snapshotAfterLogout, directory);
+
+    bool refused;
+    {
+        SummaryManager fromJournal;
+        refused = !fromJournal.openJournal(journal, EventJournal::NO_SYNC);
+    }
+
+    SummaryManager fromSnapshot;
+    uint64_t covered = 0;
+    bool ok = !expected.empty() && fromSnapshot.loadSnapshot(snapshot, &covered) &&
+              fromSnapshot.openJournal(journal, EventJournal::NO_SYNC, nullptr, covered);
+    std::string snapshotAndTail = ok ? describe(fromSnapshot, directory) : std::string();
+
+    std::cout << "snapshot " << (snapshotAfterLogout ? "after" : "before") << " logout: journal alone "
+              << (refused ? "refused" : "ACCEPTED") << ", snapshot and journal tail "
+              << (snapshotAndTail == expected ? "matches" : "DIFFERS") << std::endl;
+
+    std::remove(journal.c_str());
+    std::remove(snapshot.c_str());
+    return ok && refused && snapshotAndTail == expected;
+}
+
+static bool checkShortJournal(const std::string& directory) {
+    std::string journal = directory + "/events.jrn";
+    std::string snapshot = directory + "/events.snap";
+    std::remove(journal.c_str());
+    std::remove(snapshot.c_str());
+
+    // The journal keeps everything, then loses its last bytes up to before the snapshot's offset
+    uint64_t covered = 0;
+    {
+        SummaryManager summaries;
+        bool ok = summaries.openJournal(journal, EventJournal::NO_SYNC);
+        int step = 0;
+        for (; ok && step < 300; ++step) {
+            report(summaries, CHANNELS[step % 2], USERS[step % 3], step);
+        }
+        ok = ok && summaries.writeSnapshot(snapshot, false) && summaries.waitForSnapshot();
+        for (; ok && step < 350; ++step) {
+            report(summaries, CHANNELS[step % 2], USERS[step % 3], step);
+        }
+        SummaryManager loaded;
+        if (!ok || !loaded.loadSnapshot(snapshot, &covered) || truncate(journal.c_str(), covered - 100) != 0) {
+            std::cout << "short journal: could not set up" << std::endl;
+            return false;
+        }
+    }
+
+    std::string expected;
+    {
+        SummaryManager snapshotOnly;
+        snapshotOnly.loadSnapshot(snapshot);
+        expected = describe(snapshotOnly, directory);
+    }
+
+    std::string restored, added;
+    {
+        SummaryManager summaries;
+        if (summaries.loadSnapshot(snapshot) &&
+            summaries.openJournal(journal, EventJournal::NO_SYNC, nullptr, covered)) {
+            restored = describe(summaries, directory);
+            report(summaries, CHANNELS[0], USERS[0], 1000);
+            added = describe(summaries, directory);
+        }
+    }
+
+    std::string again;
+    {
+        SummaryManager summaries;
+        if (summaries.loadSnapshot(snapshot) &&
+            summaries.openJournal(journal, EventJournal::NO_SYNC, nullptr, covered)) {
+            again = describe(summaries, directory);
+        }
+    }
+
+    std::cout << "short journal: snapshot " << (restored == expected ? "matches" : "DIFFERS")
+              << ", events added after it " << (!added.empty() && again == added ? "kept" : "LOST") << std::endl;
+
+    std::remove(journal.c_str());
+    std::remove(snapshot.c_str());
+    return restored == expected && !added.empty() && again == added;
+}
+
+int main(int argc, char* argv[]) {
+    std::string directory = argc > 1 ? argv[1] : "/tmp";
+    std::ostringstream name;
+    name << directory << "/restart-check-" << getpid();
+    directory = name.str();
+    if (mkdir(directory.c_str(), 0700) != 0) {
+        std::cerr << "Cannot create " << directory << std::endl;
+        return 1;
+    }
+
+    bool ok = check(directory, false);
+    ok = check(directory, true) && ok;
+    ok = checkShortJournal(directory) && ok;
+    rmdir(directory.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#include "../include/StringInterner.h"
+
+StringInterner::StringInterner() : strings(), internLock() {}
+
+StringInterner& StringInterner::instance() {
+    static StringInterner pool;
+    return pool;
+}
+
+Symbol StringInterner::intern(const std::string& value) {
+    std::lock_guard<std::mutex> lock(internLock);
+    return &*strings.insert(value).first;
+}
+
+Symbol StringInterner::intern(const char* data, size_t length) {
+    return intern(std::string(data, length));
+}
+
+bool StringInterner::find(const std::string& value, Symbol& symbol) const {
+    std::lock_guard<std::mutex> lock(internLock);
+    auto it = strings.find(value);
+    if (it == strings.end()) {
+        return false;
+    }
+    symbol = &*it;
+    return true;
+}
+
+Symbol StringInterner::empty() {
+    static Symbol emptySymbol = instance().intern(std::string());
+    return emptySymbol;
+}
+
+size_t StringInterner::size() const {
+    std::lock_guard<std::mutex> lock(internLock);
+    return strings.size();
+}
@@ -0,0 +1,213 @@
+#include "../include/StructuralIndex.h"
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRUCTURAL_INDEX_X86 1
+#endif
+
+// Kernels fill masks[i] with a bit per byte of the i-th 64-byte block that is a delimiter,
+// '\n' or ':', leaving the conversion to offsets to StructuralIndex
+typedef void (*ScanFunction)(const char* data, size_t blocks, char delimiter, uint64_t* masks);
+
+static const size_t BLOCK_SIZE = 64;
+
+// Blocks turned into masks per kernel call, small enough for the masks to stay on the stack
+static const size_t BLOCKS_PER_BATCH = 16;
+
+static inline uint64_t scalarMask(const char* data, size_t size, char delimiter) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        char c = data[i];
+        if (c == delimiter || c == '\n' || c == ':') {
+            mask |= uint64_t(1) << i;
+        }
+    }
+    return mask;
+}
+
+static void scanScalar(const char* data, size_t blocks, char delimiter, uint64_t* masks) {
+    for (size_t block = 0; block < blocks; ++block) {
+        masks[block] = scalarMask(data + block * BLOCK_SIZE, BLOCK_SIZE, delimiter);
+    }
+}
+
+#ifdef STRUCTURAL_INDEX_X86
+
+__attribute__((target("sse2")))
+static void scanSse2(const char* data, size_t blocks, char delimiter, uint64_t* masks) {
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    const __m128i newlines = _mm_set1_epi8('\n');
+    const __m128i colons = _mm_set1_epi8(':');
+    for (size_t block = 0; block < blocks; ++block) {
+        uint64_t mask = 0;
+        for (size_t lane = 0; lane < BLOCK_SIZE / 16; ++lane) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + block * BLOCK_SIZE + lane * 16));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, delimiters), _mm_cmpeq_epi8(bytes, newlines)),
+                                        _mm_cmpeq_epi8(bytes, colons));
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hits))) << (lane * 16);
+        }
+        masks[block] = mask;
+    }
+}
+
+__attribute__((target("avx2")))
+static void scanAvx2(const char* data, size_t blocks, char delimiter, uint64_t* masks) {
+    const __m256i delimiters = _mm256_set1_epi8(delimiter);
+    const __m256i newlines = _mm256_set1_epi8('\n');
+    const __m256i colons = _mm256_set1_epi8(':');
+    for (size_t block = 0; block < blocks; ++block) {
+        const char* p = data + block * BLOCK_SIZE;
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+        __m256i lowHits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(low, delimiters), _mm256_cmpeq_epi8(low, newlines)),
+                _mm256_cmpeq_epi8(low, colons));
+        __m256i highHits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(high, delimiters), _mm256_cmpeq_epi8(high, newlines)),
+                _mm256_cmpeq_epi8(high, colons));
+        masks[block] = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(lowHits))) |
+                       static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(highHits))) << 32;
+    }
+}
+
+#endif
+
+static bool cpuSupports(StructuralIndex::Kernel kernel) {
+    switch (kernel) {
+        case StructuralIndex::SCALAR:
+            return true;
+#ifdef STRUCTURAL_INDEX_X86
+        case StructuralIndex::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case StructuralIndex::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static StructuralIndex::Kernel bestKernel() {
+    if (cpuSupports(StructuralIndex::AVX2)) {
+        return StructuralIndex::AVX2;
+    }
+    if (cpuSupports(StructuralIndex::SSE2)) {
+        return StructuralIndex::SSE2;
+    }
+    return StructuralIndex::SCALAR;
+}
+
+static ScanFunction scanFunction(StructuralIndex::Kernel kernel) {
+    switch (kernel) {
+#ifdef STRUCTURAL_INDEX_X86
+        case StructuralIndex::AVX2:
+            return scanAvx2;
+        case StructuralIndex::SSE2:
+            return scanSse2;
+#endif
+        default:
+            return scanScalar;
+    }
+}
+
+// The kernel in use, picked on first use
+static std::atomic<StructuralIndex::Kernel>& currentKernel() {
+    static std::atomic<StructuralIndex::Kernel> kernel(bestKernel());
+    return kernel;
+}
+
+StructuralIndex::StructuralIndex() : marks(), count(0), capacity(0) {}
+
+void StructuralIndex::reserve(size_t required) {
+    if (required <= capacity) {
+        return;
+    }
+    size_t grown = capacity == 0 ? BLOCK_SIZE : capacity;
+    while (grown < required) {
+        grown *= 2;
+    }
+    std::unique_ptr<uint32_t[]> larger(new uint32_t[grown]);
+    std::copy(marks.get(), marks.get() + count, larger.get());
+    marks.swap(larger);
+    capacity = grown;
+}
+
+void StructuralIndex::appendMask(uint64_t mask, uint32_t blockBase) {
+    // A block has at most 64 marks, so one capacity check covers it
+    reserve(count + BLOCK_SIZE);
+    uint32_t* out = marks.get() + count;
+    while (mask != 0) {
+        *out++ = blockBase + static_cast<uint32_t>(__builtin_ctzll(mask));
+        mask &= mask - 1;
+    }
+    count = out - marks.get();
+}
+
+void StructuralIndex::scan(const char* data, size_t size, char delimiter, uint32_t base) {
+    ScanFunction kernel = scanFunction(currentKernel().load(std::memory_order_relaxed));
+    uint64_t masks[BLOCKS_PER_BATCH];
+    size_t offset = 0;
+    while (size - offset >= BLOCK_SIZE) {
+        size_t blocks = std::min((size - offset) / BLOCK_SIZE, BLOCKS_PER_BATCH);
+        kernel(data + offset, blocks, delimiter, masks);
+        for (size_t block = 0; block < blocks; ++block) {
+            appendMask(masks[block], base + static_cast<uint32_t>(offset + block * BLOCK_SIZE));
+        }
+        offset += blocks * BLOCK_SIZE;
+    }
+    // The last partial block, byte by byte so nothing past size is read
+    if (offset < size) {
+        appendMask(scalarMask(data + offset, size - offset, delimiter), base + static_cast<uint32_t>(offset));
+    }
+}
+
+const uint32_t* StructuralIndex::data() const {
+    return marks.get();
+}
+
+size_t StructuralIndex::size() const {
+    return count;
+}
+
+uint32_t StructuralIndex::operator[](size_t index) const {
+    return marks[index];
+}
+
+void StructuralIndex::dropFront(size_t index) {
+    std::copy(marks.get() + index, marks.get() + count, marks.get());
+    count -= index;
+}
+
+void StructuralIndex::shift(uint32_t offset) {
+    for (size_t i = 0; i < count; ++i) {
+        marks[i] -= offset;
+    }
+}
+
+void StructuralIndex::clear() {
+    count = 0;
+}
+
+bool StructuralIndex::selectKernel(Kernel kernel) {
+    if (kernel == AUTO) {
+        kernel = bestKernel();
+    }
+    if (!cpuSupports(kernel)) {
+        return false;
+    }
+    currentKernel().store(kernel);
+    return true;
+}
+
+const char* StructuralIndex::kernelName() {
+    switch (currentKernel().load(std::memory_order_relaxed)) {
+        case AVX2:
+            return "avx2";
+        case SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
@@ -1,43 +1,290 @@
 #include "SummaryManager.h"
+#include "SummarySnapshot.h"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
 #include <iostream>
+#include <ctime>
+#include <cerrno>
 
-SummaryManager::SummaryManager() : channelData(), summaryLock() {}
+EventIndex::EventIndex() : events(), activeCount(0), forcesArrivalCount(0) {}
 
-SummaryManager::~SummaryManager() {}
+EventBucket::EventBucket() : arena(), index(std::make_shared<EventIndex>()), snapshots() {}
+
+// Summary order: by date_time, and then by event name lexicographically
+static bool reportedBefore(const StoredEvent* a, const StoredEvent* b) {
+    if (a->dateTime != b->dateTime) {
+        return a->dateTime < b->dateTime;
+    }
+    return a->name != b->name && *a->name < *b->name;
+}
+
+void EventIndex::insert(const StoredEvent* event) {
+    // Reports arrive sorted by time, so the event nearly always goes at the end
+    if (events.empty() || !reportedBefore(event, events.back())) {
+        events.push_back(event);
+    } else {
+        events.insert(std::upper_bound(events.begin(), events.end(), event, reportedBefore), event);
+    }
+    if (event->generalFlags & ACTIVE_TRUE) activeCount++;
+    if (event->generalFlags & FORCES_ARRIVAL_TRUE) forcesArrivalCount++;
+}
+
+void EventBucket::insert(const StoredEvent* event) {
+    // Snapshots are only taken under the lock, so a unique index cannot gain a reader while it is changed
+    if (index.use_count() > 1) {
+        index = std::make_shared<EventIndex>(*index);
+    }
+    index->insert(event);
+}
+
+SummaryManager::SummaryManager() : channelData(), channelIndex(), channelColumns(), columnar(false), journal(),
+                                   snapshotWrite(), summaryLock() {}
+
+SummaryManager::~SummaryManager() {
+    waitForSnapshot(); // It may still flush the journal
+}
+
+ChannelIndex::Block::Block(size_t position)
+    : events(), minTime(0), maxTime(0), position(position), users(), cities() {}
+
+ChannelIndex::ChannelIndex() : blocks(), userBlocks(), cityBlocks() {}
+
+void ChannelIndex::insert(Symbol user, const StoredEvent* event) {
+    IndexedEvent indexed = {user, event};
+    int time = event->dateTime;
+    Block* block;
+    if (blocks.empty() || blocks.back()->maxTime <= time) {
+        // Events mostly arrive in time order, which only ever appends to the last block
+        if (blocks.empty() || blocks.back()->events.size() >= BLOCK_EVENTS) {
+            blocks.emplace_back(new Block(blocks.size()));
+        }
+        block = blocks.back().get();
+        block->events.push_back(indexed);
+    } else {
+        // The first block ending after time: the ones before end at or before it, so equal
+        // times stay in arrival order
+        auto at = std::upper_bound(blocks.begin(), blocks.end(), time,
+                                   [](int t, const std::unique_ptr<Block>& b) { return t < b->maxTime; });
+        block = at->get();
+        auto position = std::upper_bound(block->events.begin(), block->events.end(), time,
+                                         [](int t, const IndexedEvent& e) { return t < e.event->dateTime; });
+        block->events.insert(position, indexed);
+    }
+    if (block->events.size() == 1) {
+        block->minTime = block->maxTime = time;
+    } else {
+        block->minTime = std::min(block->minTime, time);
+        block->maxTime = std::max(block->maxTime, time);
+    }
+    note(*block, user, event->city);
+    if (block->events.size() > BLOCK_EVENTS) {
+        split(*block);
+    }
+}
+
+// Symbols are few per block, so a short scan beats a set
+void ChannelIndex::note(Block& block, Symbol user, Symbol city) {
+    if (std::find(block.users.begin(), block.users.end(), user) == block.users.end()) {
+        block.users.push_back(user);
+        userBlocks[user].push_back(&block);
+    }
+    if (std::find(block.cities.begin(), block.cities.end(), city) == block.cities.end()) {
+        block.cities.push_back(city);
+        cityBlocks[city].push_back(&block);
+    }
+}
+
+void ChannelIndex::dropRef(BlockRefs& refs, Symbol symbol, Block* block) {
+    auto found = refs.find(symbol);
+    if (found == refs.end()) {
+        return;
+    }
+    std::vector<Block*>& holding = found->second;
+    holding.erase(std::remove(holding.begin(), holding.end(), block), holding.end());
+    if (holding.empty()) {
+        refs.erase(found);
+    }
+}
+
+void ChannelIndex::unlink(Block& block) {
+    for (Symbol user : block.users) {
+        dropRef(userBlocks, user, &block);
+    }
+    for (Symbol city : block.cities) {
+        dropRef(cityBlocks, city, &block);
+    }
+    block.users.clear();
+    block.cities.clear();
+}
+
+void ChannelIndex::summarize(Block& block) {
+    unlink(block);
+    if (block.events.empty()) {
+        return;
+    }
+    block.minTime = block.events.front().event->dateTime;
+    block.maxTime = block.events.back().event->dateTime;
+    for (const IndexedEvent& entry : block.events) {
+        note(block, entry.user, entry.event->city);
+    }
+}
+
+void ChannelIndex::split(Block& block) {
+    size_t position = block.position + 1;
+    std::unique_ptr<Block> upper(new Block(position));
+    auto half = block.events.begin() + block.events.size() / 2;
+    upper->events.assign(half, block.events.end());
+    block.events.erase(half, block.events.end());
+    summarize(block);
+    summarize(*upper);
+    blocks.insert(blocks.begin() + position, std::move(upper));
+    renumber(position + 1);
+}
+
+void ChannelIndex::renumber(size_t from) {
+    for (size_t i = from; i < blocks.size(); ++i) {
+        blocks[i]->position = i;
+    }
+}
+
+void ChannelIndex::removeUser(Symbol user) {
+    auto found = userBlocks.find(user);
+    if (found == userBlocks.end()) {
+        return;
+    }
+    std::vector<Block*> holding;
+    holding.swap(found->second);
+    userBlocks.erase(found);
+
+    bool emptied = false;
+    for (Block* block : holding) {
+        block->events.erase(std::remove_if(block->events.begin(), block->events.end(),
+                                           [user](const IndexedEvent& entry) { return entry.user == user; }),
+                            block->events.end());
+        summarize(*block);
+        emptied = emptied || block->events.empty();
+    }
+    if (emptied) {
+        blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                    [](const std::unique_ptr<Block>& block) { return block->events.empty(); }),
+                     blocks.end());
+        renumber(0);
+    }
+}
+
+void ChannelIndex::forEach(const EntryVisitor& visit) const {
+    for (const std::unique_ptr<Block>& block : blocks) {
+        for (const IndexedEvent& entry : block->events) {
+            visit(entry);
+        }
+    }
+}
+
+void ChannelIndex::forEachBetween(int from, int to, const EntryVisitor& visit) const {
+    // Skip the blocks ending before from, then stop at the first one starting after to
+    auto at = std::lower_bound(blocks.begin(), blocks.end(), from,
+                               [](const std::unique_ptr<Block>& b, int t) { return b->maxTime < t; });
+    for (; at != blocks.end() && (*at)->minTime <= to; ++at) {
+        for (const IndexedEvent& entry : (*at)->events) {
+            if (entry.event->dateTime >= from && entry.event->dateTime <= to) {
+                visit(entry);
+            }
+        }
+    }
+}
+
+void ChannelIndex::forEachLatestInCity(Symbol city, size_t count, const EntryVisitor& visit) const {
+    auto found = cityBlocks.find(city);
+    if (found == cityBlocks.end() || count == 0) {
+        return;
+    }
+    // Walk back through the blocks holding the city, from the newest
+    std::vector<const Block*> holding(found->second.begin(), found->second.end());
+    std::sort(holding.begin(), holding.end(),
+              [](const Block* a, const Block* b) { return a->position > b->position; });
+    for (const Block* block : holding) {
+        for (auto entry = block->events.rbegin(); entry != block->events.rend(); ++entry) {
+            if (entry->event->city == city) {
+                visit(*entry);
+                if (--count == 0) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void SummaryManager::place(EventBucket& bucket, ChannelIndex& index, ColumnStore* columns, Symbol user,
+                           const StoredEvent& event) {
+    StoredEvent stored = event;
+    stored.description = bucket.arena.copy(event.description, event.descriptionLength);
+    link(bucket, index, columns, user, bucket.arena.create(stored));
+}
+
+void SummaryManager::link(EventBucket& bucket, ChannelIndex& index, ColumnStore* columns, Symbol user,
+                          const StoredEvent* placed) {
+    bucket.insert(placed);
+    index.insert(user, placed);
+    if (columns) {
+        columns->append(user, placed->city, placed->name, placed->dateTime, placed->generalFlags);
+    }
+}
 
 void SummaryManager::addEvent(const std::string& channel, const std::string& user, const Event& event) {
     std::lock_guard<std::mutex> lock(summaryLock);
-    channelData[channel][user].push_back(event);
+    std::shared_ptr<EventBucket>& bucket = channelData[channel][user];
+    if (!bucket) {
+        bucket.reset(new EventBucket());
+    }
+
+    const std::string& description = event.get_description();
+    StoredEvent stored = {event.city_symbol(), event.name_symbol(), event.get_date_time(), event.get_general_flags(),
+                          description.data(), description.size()};
+    place(*bucket, channelIndex[channel], columnar ? &channelColumns[channel] : nullptr,
+          StringInterner::instance().intern(user), stored);
+    if (journal.isOpen()) {
+        // Only copied into the pending batch here, the committer thread does the write
+        journal.append(channel, user, *stored.city, *stored.name, stored.dateTime, stored.generalFlags,
+                       description.data(), description.size());
+    }
+}
+
+void SummaryManager::addEvent(const std::string& channel, const std::string& user, Event&& event) {
+    Event taken(std::move(event)); // Dropped on return, after the lock is released
+    addEvent(channel, user, static_cast<const Event&>(taken));
 }
 
 void SummaryManager::generateSummary(const std::string& channel, const std::string& user, const std::string& filePath) const {
-    std::lock_guard<std::mutex> lock(summaryLock);
+    // Snapshot the bucket under the lock, the rest runs without it
+    std::shared_ptr<const EventBucket> bucket;
+    std::shared_ptr<const EventIndex> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(summaryLock);
+        auto channelIt = channelData.find(channel);
+        if (channelIt != channelData.end()) {
+            auto userIt = channelIt->second.find(user);
+            if (userIt != channelIt->second.end()) {
+                bucket = userIt->second;
+                snapshot = bucket->index;
+            }
+        }
+    }
 
     // Check if channel and user data exists
-    if (channelData.find(channel) == channelData.end() || channelData.at(channel).find(user) == channelData.at(channel).end()) {
+    if (!bucket) {
         std::cout << "No data found for channel: " << channel << ", user: " << user << std::endl;
         return;
     }
 
-    auto events = channelData.at(channel).at(user); // Copy events to sort
+    const std::vector<const StoredEvent*>& events = snapshot->events; // Already in summary order
 
     if (events.empty()) {
         std::cout << "No events to summarize for channel: " << channel << ", user: " << user << std::endl;
         return;
     }
 
-    // Sort events by date_time, and then by event name lexicographically
-    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
-        if (a.get_date_time() != b.get_date_time()) {
-            return a.get_date_time() < b.get_date_time(); // Sort by date_time
-        }
-        return a.get_name() < b.get_name(); // If date_time is the same, sort by event name
-    });
-
     // Open the output file
     std::ofstream outFile(filePath, std::ios::trunc); // Truncate if the file exists
     if (!outFile.is_open()) {
@@ -45,38 +292,30 @@ void SummaryManager::generateSummary(const std::string& channel, const std::stri
         return;
     }
 
-    // Calculate statistics
-    int totalReports = events.size();
-    int activeCount = 0;
-    int forcesArrivalCount = 0;
-
-    for (const auto& event : events) {
-        if (event.get_general_information().at("active") == "true") activeCount++;
-        if (event.get_general_information().at("forces_arrival_at_scene") == "true") forcesArrivalCount++;
-    }
-
-    // Write summary header
+    // Write summary header, the statistics were counted as the events arrived
     outFile << "Channel " << channel << "\n";
     outFile << "Stats:\n";
-    outFile << "Total: " << totalReports << "\n";
-    outFile << "active: " << activeCount << "\n";
-    outFile << "forces arrival at scene: " << forcesArrivalCount << "\n\n";
+    outFile << "Total: " << events.size() << "\n";
+    outFile << "active: " << snapshot->activeCount << "\n";
+    outFile << "forces arrival at scene: " << snapshot->forcesArrivalCount << "\n\n";
     outFile << "Event Reports:\n\n";
 
     // Write event details
     for (size_t i = 0; i < events.size(); ++i) {
-        const auto& event = events[i];
+        const StoredEvent& event = *events[i];
         outFile << "Report_" << (i + 1) << ":\n";
-        outFile << "city: " << event.get_city() << "\n";
-        outFile << "date time: " << epochToDate(event.get_date_time()) << "\n";
-        outFile << "event name: " << event.get_name() << "\n";
+        outFile << "city: " << *event.city << "\n";
+        outFile << "date time: " << epochToDate(event.dateTime) << "\n";
+        outFile << "event name: " << *event.name << "\n";
 
         // Truncate description for summary
-        std::string description = event.get_description();
-        if (description.size() > 27) {
-            description = description.substr(0, 27) + "...";
+        outFile << "summary: ";
+        if (event.descriptionLength > 27) {
+            outFile.write(event.description, 27) << "...";
+        } else {
+            outFile.write(event.description, event.descriptionLength);
         }
-        outFile << "summary: " << description << "\n\n";
+        outFile << "\n\n";
     }
 
     outFile.close();
@@ -84,26 +323,273 @@ void SummaryManager::generateSummary(const std::string& channel, const std::stri
 }
 
 
-std::string SummaryManager::epochToDate(int epochTime) const {
+bool SummaryManager::openJournal(const std::string& path, EventJournal::SyncPolicy policy, size_t* replayed,
+                                 uint64_t skipBytes) {
+    std::lock_guard<std::mutex> lock(summaryLock);
+    StringInterner& interner = StringInterner::instance();
+
+    // Records come in runs from one channel and user, so their bucket is looked up once per run
+    std::string channel, user;
+    EventBucket* bucket = nullptr;
+    ChannelIndex* index = nullptr;
+    ColumnStore* columns = nullptr;
+    Symbol userSymbol = nullptr;
+    return journal.open(path, policy, [&](const JournalRecord& record) {
+        if (record.clearsUser) {
+            dropUser(std::string(record.user.data, record.user.size));
+            bucket = nullptr; // It may just have been dropped
+            return;
+        }
+        if (!bucket || channel.compare(0, std::string::npos, record.channel.data, record.channel.size) != 0 ||
+            user.compare(0, std::string::npos, record.user.data, record.user.size) != 0) {
+            channel.assign(record.channel.data, record.channel.size);
+            user.assign(record.user.data, record.user.size);
+            std::shared_ptr<EventBucket>& slot = channelData[channel][user];
+            if (!slot) {
+                slot.reset(new EventBucket());
+            }
+            bucket = slot.get();
+            index = &channelIndex[channel];
+            columns = columnar ? &channelColumns[channel] : nullptr;
+            userSymbol = interner.intern(user);
+        }
+        StoredEvent stored = {interner.intern(record.city.data, record.city.size),
+                              interner.intern(record.name.data, record.name.size), record.dateTime,
+                              record.generalFlags, record.description.data, record.description.size};
+        place(*bucket, *index, columns, userSymbol, stored);
+    }, replayed, skipBytes);
+}
+
+bool SummaryManager::writeSnapshot(const std::string& path, bool rollJournal) {
+    std::lock_guard<std::mutex> lock(summaryLock);
+    if (snapshotWrite.valid() &&
+        snapshotWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+
+    // Only the bucket and index pointers are copied under the lock
+    std::vector<SnapshotChannel> view;
+    for (auto& channel : channelData) {
+        SnapshotChannel captured;
+        captured.name = channel.first;
+        for (auto& user : channel.second) {
+            SnapshotBucket bucket = {StringInterner::instance().intern(user.first), user.second, user.second->index};
+            captured.buckets.push_back(bucket);
+        }
+        view.push_back(std::move(captured));
+    }
+    // Appends happen under this lock, so the journal length matches the view exactly
+    uint64_t journalOffset = journal.isOpen() ? journal.size() : 0;
+
+    snapshotWrite = std::async(std::launch::async, [this, path, view, journalOffset, rollJournal] {
+        // The snapshot may only claim journal bytes that are already on disk
+        if (journalOffset > 0 && !journal.flush()) {
+            return false;
+        }
+        if (!SummarySnapshot::write(path, view, journalOffset)) {
+            return false;
+        }
+        // The journal keeps what it had if this fails, which still restores on top of the snapshot
+        if (rollJournal && journalOffset > 0) {
+            journal.rollOver(journalOffset);
+        }
+        return true;
+    });
+    return true;
+}
+
+bool SummaryManager::waitForSnapshot() {
+    std::future<bool> pending;
+    {
+        std::lock_guard<std::mutex> lock(summaryLock);
+        pending = std::move(snapshotWrite);
+    }
+    return !pending.valid() || pending.get();
+}
+
+bool SummaryManager::loadSnapshot(const std::string& path, uint64_t* journalOffset, size_t* loaded) {
+    SummarySnapshot snapshot;
+    errno = 0;
+    if (!snapshot.open(path)) {
+        return errno == ENOENT;
+    }
+    if (journalOffset) {
+        *journalOffset = snapshot.journalOffset();
+    }
+    if (loaded) {
+        *loaded = snapshot.eventCount();
+    }
+
+    std::lock_guard<std::mutex> lock(summaryLock);
+    std::shared_ptr<const MappedFile> backing = snapshot.backing();
+
+    // Events come channel by channel, each channel's users interleaved in time order
+    Symbol channel = nullptr;
+    std::map<std::string, std::shared_ptr<EventBucket>>* users = nullptr;
+    ChannelIndex* index = nullptr;
+    ColumnStore* columns = nullptr;
+    std::unordered_map<Symbol, EventBucket*> buckets;
+    snapshot.forEachEvent([&](Symbol eventChannel, Symbol user, const StoredEvent& event) {
+        if (eventChannel != channel) {
+            channel = eventChannel;
+            users = &channelData[*channel];
+            index = &channelIndex[*channel];
+            columns = columnar ? &channelColumns[*channel] : nullptr;
+            buckets.clear();
+        }
+        EventBucket*& bucket = buckets[user];
+        if (!bucket) {
+            std::shared_ptr<EventBucket>& slot = (*users)[*user];
+            if (!slot) {
+                slot.reset(new EventBucket());
+            }
+            if (slot->snapshots.empty() || slot->snapshots.back() != backing) {
+                slot->snapshots.push_back(backing);
+            }
+            bucket = slot.get();
+        }
+        // Only the record is stored, its description stays in the mapping until a summary reads it
+        link(*bucket, *index, columns, user, bucket->arena.create(event));
+    });
+    return true;
+}
+
+std::string SummaryManager::epochToDate(int64_t epochTime) const {
     std::time_t time = static_cast<std::time_t>(epochTime);
-    std::tm* tm = std::localtime(&time);
+    std::tm tm;
+    localtime_r(&time, &tm); // Summaries are written outside the lock, possibly several at once
 
     std::ostringstream oss;
-    oss << std::put_time(tm, "%d/%m/%Y %H:%M");
+    oss << std::put_time(&tm, "%d/%m/%Y %H:%M");
     return oss.str();
 }
 
-void SummaryManager::clear() {
+EventRecord SummaryManager::toRecord(const IndexedEvent& indexed) {
+    const StoredEvent& event = *indexed.event;
+    EventRecord record = {indexed.user, event.city, event.name, event.dateTime,
+                          std::string(event.description, event.descriptionLength)};
+    return record;
+}
+
+std::vector<EventRecord> SummaryManager::eventsBetween(const std::string& channel, int from, int to) const {
+    std::vector<EventRecord> records;
+    std::lock_guard<std::mutex> lock(summaryLock);
+    auto index = channelIndex.find(channel);
+    if (index == channelIndex.end() || from > to) {
+        return records;
+    }
+    index->second.forEachBetween(from, to, [&records](const IndexedEvent& entry) {
+        records.push_back(toRecord(entry));
+    });
+    return records;
+}
+
+std::vector<EventRecord> SummaryManager::latestInCity(const std::string& channel, const std::string& city,
+                                                      size_t count) const {
+    std::vector<EventRecord> records;
+    // A city nobody reported has no events, and asking must not grow the pool
+    Symbol citySymbol = nullptr;
+    if (!StringInterner::instance().find(city, citySymbol)) {
+        return records;
+    }
     std::lock_guard<std::mutex> lock(summaryLock);
-    channelData.clear();
+    auto index = channelIndex.find(channel);
+    if (index == channelIndex.end()) {
+        return records;
+    }
+    // Newest first, then restore time order
+    index->second.forEachLatestInCity(citySymbol, count, [&records](const IndexedEvent& entry) {
+        records.push_back(toRecord(entry));
+    });
+    std::reverse(records.begin(), records.end());
+    return records;
 }
 
-void SummaryManager::clearClientData(const std::string& clientName) {
+void SummaryManager::setColumnar(bool enabled) {
+    std::lock_guard<std::mutex> lock(summaryLock);
+    if (enabled == columnar) {
+        return;
+    }
+    columnar = enabled;
+    channelColumns.clear();
+    if (!enabled) {
+        return;
+    }
+    // Load what is already stored, in time order
+    for (auto& channel : channelIndex) {
+        ColumnStore& columns = channelColumns[channel.first];
+        channel.second.forEach([&columns](const IndexedEvent& entry) {
+            const StoredEvent& event = *entry.event;
+            columns.append(entry.user, event.city, event.name, event.dateTime, event.generalFlags);
+        });
+    }
+}
+
+bool SummaryManager::isColumnar() const {
+    std::lock_guard<std::mutex> lock(summaryLock);
+    return columnar;
+}
+
+ColumnCounts SummaryManager::channelCounts(const std::string& channel) const {
+    std::lock_guard<std::mutex> lock(summaryLock);
+    auto columns = channelColumns.find(channel);
+    if (columns == channelColumns.end()) {
+        ColumnCounts none = {0, 0, 0, 0};
+        return none;
+    }
+    return columns->second.counts();
+}
+
+std::vector<std::pair<Symbol, size_t>> SummaryManager::countByCity(const std::string& channel) const {
+    std::lock_guard<std::mutex> lock(summaryLock);
+    auto columns = channelColumns.find(channel);
+    if (columns == channelColumns.end()) {
+        return std::vector<std::pair<Symbol, size_t>>();
+    }
+    return columns->second.countByCity();
+}
+
+std::vector<size_t> SummaryManager::histogram(const std::string& channel, int from, int bucketSeconds,
+                                              size_t buckets) const {
+    if (buckets > MAX_HISTOGRAM_BUCKETS) {
+        return std::vector<size_t>();
+    }
+    std::lock_guard<std::mutex> lock(summaryLock);
+    auto columns = channelColumns.find(channel);
+    if (columns == channelColumns.end()) {
+        return std::vector<size_t>(buckets, 0);
+    }
+    return columns->second.histogram(from, bucketSeconds, buckets);
+}
+
+void SummaryManager::clear() {
     std::lock_guard<std::mutex> lock(summaryLock);
+    channelColumns.clear();
+    channelIndex.clear();
+    channelData.clear(); // Each bucket frees its arena chunks
+}
+
+void SummaryManager::dropUser(const std::string& user) {
+    // Unindex the user's events before their arenas go
+    Symbol symbol = StringInterner::instance().intern(user);
+    for (auto it = channelIndex.begin(); it != channelIndex.end(); ++it) {
+        it->second.removeUser(symbol);
+    }
+    for (auto it = channelColumns.begin(); it != channelColumns.end(); ++it) {
+        it->second.removeUser(symbol);
+    }
 
-    // Iterate through all channels and remove the client's data
+    // Iterate through all channels and remove the user's data, along with its arena
     for (auto it = channelData.begin(); it != channelData.end(); ++it) {
-        it->second.erase(clientName);
+        it->second.erase(user);
     }
 }
 
+void SummaryManager::clearClientData(const std::string& clientName) {
+    std::lock_guard<std::mutex> lock(summaryLock);
+    dropUser(clientName);
+    if (journal.isOpen()) {
+        // Appended under the lock like events, so a snapshot's journal length falls on one side of it
+        journal.appendClearUser(clientName);
+    }
+}
@@ -0,0 +1,365 @@
+#include "../include/SummarySnapshot.h"
+#include "../include/ColumnStore.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <queue>
+
+static const char MAGIC[] = {'E', 'M', 'I', 'S', 'N', 'A', 'P', '\0'};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t channelCount;
+    uint32_t userCount;
+    uint32_t cityCount;
+    uint32_t nameCount;
+    uint32_t reserved;
+    uint64_t eventCount;
+    uint64_t journalOffset;
+    uint64_t tablesOffset;
+    uint64_t channelsOffset;
+    uint64_t eventsOffset;
+    uint64_t blobOffset;
+    uint64_t blobSize;
+};
+
+struct SnapshotEvent {
+    uint64_t descriptionOffset; // In the blob
+    uint32_t descriptionLength;
+    int32_t dateTime;
+    uint32_t user;
+    uint32_t city;
+    uint32_t name;
+    uint8_t generalFlags;
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "sections after the header stay 8 byte aligned");
+static_assert(sizeof(SnapshotEvent) == 32, "event records are fixed width");
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// Buffered writes to a file descriptor, remembering the first error
+class SnapshotWriter {
+private:
+    int fd;
+    std::vector<char> buffer;
+    uint64_t written;
+    bool ok;
+
+public:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    explicit SnapshotWriter(int descriptor) : fd(descriptor), buffer(), written(0), ok(true) {
+        buffer.reserve(BUFFER_SIZE);
+    }
+
+    void write(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        if (buffer.size() + size > BUFFER_SIZE) {
+            flush();
+        }
+        if (size >= BUFFER_SIZE) {
+            writeOut(bytes, size);
+        } else {
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+        written += size;
+    }
+
+    void padTo(uint64_t offset) {
+        static const char zeros[8] = {0};
+        write(zeros, offset - written);
+    }
+
+    bool flush() {
+        writeOut(buffer.data(), buffer.size());
+        buffer.clear();
+        return ok;
+    }
+
+private:
+    void writeOut(const char* data, size_t size) {
+        while (ok && size > 0) {
+            ssize_t count = ::write(fd, data, size);
+            if (count < 0) {
+                ok = errno == EINTR;
+                continue;
+            }
+            data += count;
+            size -= count;
+        }
+    }
+};
+
+// A channel's events in snapshot order
+struct OrderedEvent {
+    uint32_t user;
+    const StoredEvent* event;
+};
+
+// Next unmerged event of one bucket, the heap yields the earliest, ties in bucket order
+struct MergeCursor {
+    int dateTime;
+    size_t bucket;
+    size_t position;
+
+    bool operator>(const MergeCursor& other) const {
+        return dateTime != other.dateTime ? dateTime > other.dateTime : bucket > other.bucket;
+    }
+};
+
+static void mergeChannel(const SnapshotChannel& channel, SymbolDictionary& users, std::vector<OrderedEvent>& out) {
+    std::vector<uint32_t> userIds;
+    std::priority_queue<MergeCursor, std::vector<MergeCursor>, std::greater<MergeCursor>> heap;
+    for (size_t i = 0; i < channel.buckets.size(); ++i) {
+        userIds.push_back(users.encode(channel.buckets[i].user));
+        const std::vector<const StoredEvent*>& events = channel.buckets[i].index->events;
+        if (!events.empty()) {
+            MergeCursor first = {events[0]->dateTime, i, 0};
+            heap.push(first);
+        }
+    }
+    while (!heap.empty()) {
+        MergeCursor next = heap.top();
+        heap.pop();
+        const std::vector<const StoredEvent*>& events = channel.buckets[next.bucket].index->events;
+        OrderedEvent ordered = {userIds[next.bucket], events[next.position]};
+        out.push_back(ordered);
+        if (++next.position < events.size()) {
+            next.dateTime = events[next.position]->dateTime;
+            heap.push(next);
+        }
+    }
+}
+
+static uint64_t tableSize(const SymbolDictionary& table) {
+    uint64_t size = 0;
+    for (uint32_t id = 0; id < table.size(); ++id) {
+        size += sizeof(uint32_t) + table.decode(id)->size();
+    }
+    return size;
+}
+
+static void writeString(SnapshotWriter& out, const std::string& value) {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    out.write(&length, sizeof(length));
+    out.write(value.data(), value.size());
+}
+
+static void writeTable(SnapshotWriter& out, const SymbolDictionary& table) {
+    for (uint32_t id = 0; id < table.size(); ++id) {
+        writeString(out, *table.decode(id));
+    }
+}
+
+bool SummarySnapshot::write(const std::string& path, const std::vector<SnapshotChannel>& view,
+                            uint64_t journalOffset) {
+    // Put every channel's events in time order and number the strings they use
+    SymbolDictionary channelNames, users, cities, names;
+    std::vector<OrderedEvent> order;
+    std::vector<uint64_t> channelEvents;
+    uint64_t blobSize = 0;
+    for (const SnapshotChannel& channel : view) {
+        channelNames.encode(StringInterner::instance().intern(channel.name));
+        size_t first = order.size();
+        mergeChannel(channel, users, order);
+        channelEvents.push_back(order.size() - first);
+    }
+    for (const OrderedEvent& ordered : order) {
+        cities.encode(ordered.event->city);
+        names.encode(ordered.event->name);
+        blobSize += ordered.event->descriptionLength;
+    }
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.channelCount = static_cast<uint32_t>(channelNames.size());
+    header.userCount = static_cast<uint32_t>(users.size());
+    header.cityCount = static_cast<uint32_t>(cities.size());
+    header.nameCount = static_cast<uint32_t>(names.size());
+    header.eventCount = order.size();
+    header.journalOffset = journalOffset;
+    header.tablesOffset = sizeof(SnapshotHeader);
+    header.channelsOffset = alignUp(header.tablesOffset + tableSize(channelNames) + tableSize(users) +
+                                    tableSize(cities) + tableSize(names));
+    header.eventsOffset = header.channelsOffset + channelEvents.size() * sizeof(uint64_t);
+    header.blobOffset = header.eventsOffset + order.size() * sizeof(SnapshotEvent);
+    header.blobSize = blobSize;
+
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not write snapshot " << temporary << " (Error: " << std::strerror(errno) << ')'
+                  << std::endl;
+        return false;
+    }
+
+    SnapshotWriter out(fd);
+    out.write(&header, sizeof(header));
+    writeTable(out, channelNames);
+    writeTable(out, users);
+    writeTable(out, cities);
+    writeTable(out, names);
+    out.padTo(header.channelsOffset);
+    out.write(channelEvents.data(), channelEvents.size() * sizeof(uint64_t));
+
+    uint64_t descriptionOffset = 0;
+    for (const OrderedEvent& ordered : order) {
+        const StoredEvent& event = *ordered.event;
+        SnapshotEvent record;
+        std::memset(&record, 0, sizeof(record));
+        record.descriptionOffset = descriptionOffset;
+        record.descriptionLength = static_cast<uint32_t>(event.descriptionLength);
+        record.dateTime = event.dateTime;
+        record.user = ordered.user;
+        cities.find(event.city, record.city);
+        names.find(event.name, record.name);
+        record.generalFlags = event.generalFlags;
+        out.write(&record, sizeof(record));
+        descriptionOffset += event.descriptionLength;
+    }
+    for (const OrderedEvent& ordered : order) {
+        out.write(ordered.event->description, ordered.event->descriptionLength);
+    }
+
+    bool ok = out.flush() && fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    ok = ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+    // The rename itself is only durable once the directory is synced
+    ok = ok && syncParentDirectory(path);
+    if (!ok) {
+        std::cerr << "Could not write snapshot " << path << " (Error: " << std::strerror(errno) << ')' << std::endl;
+        ::unlink(temporary.c_str());
+    }
+    return ok;
+}
+
+SnapshotChannel::SnapshotChannel() : name(), buckets() {}
+
+SummarySnapshot::SummarySnapshot()
+    : file(), journalOffset_(0), eventCount_(0), channels(), users(), cities(), names(), channelEvents(),
+      events(nullptr), blob(nullptr) {}
+
+// Intern count strings starting at cursor, false if they run past end
+static bool readTable(const char*& cursor, const char* end, uint32_t count, std::vector<Symbol>& table) {
+    StringInterner& interner = StringInterner::instance();
+    table.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t length;
+        if (end - cursor < static_cast<ptrdiff_t>(sizeof(length))) {
+            return false;
+        }
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (static_cast<uint64_t>(end - cursor) < length) {
+            return false;
+        }
+        table.push_back(interner.intern(cursor, length));
+        cursor += length;
+    }
+    return true;
+}
+
+bool SummarySnapshot::open(const std::string& path) {
+    std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>();
+    if (!mapped->open(path)) {
+        return false;
+    }
+
+    const char* data = mapped->data();
+    uint64_t size = mapped->size();
+    SnapshotHeader header;
+    if (size < sizeof(header)) {
+        std::cerr << "Not a snapshot: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "Not a snapshot: " << path << std::endl;
+        return false;
+    }
+    if (header.version != VERSION) {
+        std::cerr << "Unsupported snapshot version " << header.version << ": " << path << std::endl;
+        return false;
+    }
+
+    // Sections must follow each other inside the file
+    bool fits = header.tablesOffset <= header.channelsOffset && header.channelsOffset <= size &&
+                (size - header.channelsOffset) / sizeof(uint64_t) >= header.channelCount &&
+                header.eventsOffset >= header.channelsOffset + header.channelCount * sizeof(uint64_t) &&
+                header.eventsOffset <= size && (size - header.eventsOffset) / sizeof(SnapshotEvent) >= header.eventCount &&
+                header.blobOffset >= header.eventsOffset + header.eventCount * sizeof(SnapshotEvent) &&
+                header.blobOffset <= size && size - header.blobOffset >= header.blobSize;
+    const char* cursor = data + header.tablesOffset;
+    const char* tablesEnd = data + header.channelsOffset;
+    fits = fits && readTable(cursor, tablesEnd, header.channelCount, channels) &&
+           readTable(cursor, tablesEnd, header.userCount, users) &&
+           readTable(cursor, tablesEnd, header.cityCount, cities) &&
+           readTable(cursor, tablesEnd, header.nameCount, names);
+
+    uint64_t total = 0;
+    channelEvents.assign(header.channelCount, 0);
+    if (fits && header.channelCount > 0) {
+        std::memcpy(channelEvents.data(), data + header.channelsOffset, header.channelCount * sizeof(uint64_t));
+        for (uint64_t count : channelEvents) {
+            total += count;
+        }
+    }
+    fits = fits && total == header.eventCount;
+
+    // Check every record up front, so a load never stops halfway
+    for (uint64_t i = 0; fits && i < header.eventCount; ++i) {
+        SnapshotEvent record;
+        std::memcpy(&record, data + header.eventsOffset + i * sizeof(record), sizeof(record));
+        fits = record.user < header.userCount && record.city < header.cityCount && record.name < header.nameCount &&
+               record.descriptionOffset <= header.blobSize &&
+               header.blobSize - record.descriptionOffset >= record.descriptionLength;
+    }
+    if (!fits) {
+        std::cerr << "Damaged snapshot: " << path << std::endl;
+        return false;
+    }
+
+    file = mapped;
+    journalOffset_ = header.journalOffset;
+    eventCount_ = header.eventCount;
+    events = data + header.eventsOffset;
+    blob = data + header.blobOffset;
+    return true;
+}
+
+void SummarySnapshot::forEachEvent(const EventVisitor& visit) const {
+    const char* record = events;
+    for (size_t channel = 0; channel < channels.size(); ++channel) {
+        for (uint64_t i = 0; i < channelEvents[channel]; ++i, record += sizeof(SnapshotEvent)) {
+            SnapshotEvent fixed;
+            std::memcpy(&fixed, record, sizeof(fixed));
+            StoredEvent event = {cities[fixed.city], names[fixed.name], fixed.dateTime, fixed.generalFlags,
+                                 blob + fixed.descriptionOffset, fixed.descriptionLength};
+            visit(channels[channel], users[fixed.user], event);
+        }
+    }
+}
+
+uint64_t SummarySnapshot::journalOffset() const {
+    return journalOffset_;
+}
+
+uint64_t SummarySnapshot::eventCount() const {
+    return eventCount_;
+}
+
+std::shared_ptr<const MappedFile> SummarySnapshot::backing() const {
+    return file;
+}
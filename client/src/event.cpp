@@ -1,5 +1,6 @@
 #include "../include/event.h"
 #include "../include/json.hpp"
+#include "../include/MappedFile.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -7,42 +8,69 @@
 #include <vector>
 #include <sstream>
 #include <cstring>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
 
 using namespace std;
 using json = nlohmann::json;
 
 Event::Event(std::string channel_name, std::string city, std::string name, int date_time,
              std::string description, std::map<std::string, std::string> general_information)
-    : channel_name(channel_name), city(city), name(name),
-      date_time(date_time), description(description), general_information(general_information), eventOwnerUser("")
+    : channel_name(StringInterner::instance().intern(channel_name)), city(StringInterner::instance().intern(city)),
+      name(StringInterner::instance().intern(name)), date_time(date_time), description(std::move(description)),
+      general_flags(0), extra_information(), eventOwnerUser(StringInterner::empty())
 {
+    set_general_information(general_information);
 }
 
 Event::~Event()
 {
 }
 
+// takes the values out of general_information
+void Event::set_general_information(std::map<std::string, std::string> &general_information)
+{
+    general_flags = 0;
+    extra_information.clear();
+    for (auto &entry : general_information)
+    {
+        bool is_bool = entry.second == "true" || entry.second == "false";
+        bool is_true = entry.second == "true";
+        if (is_bool && entry.first == "active")
+            general_flags |= ACTIVE_PRESENT | (is_true ? ACTIVE_TRUE : 0);
+        else if (is_bool && entry.first == "forces_arrival_at_scene")
+            general_flags |= FORCES_ARRIVAL_PRESENT | (is_true ? FORCES_ARRIVAL_TRUE : 0);
+        else
+            extra_information.emplace_back(entry.first, std::move(entry.second)); // map order keeps the vector sorted
+    }
+}
+
 void Event::setEventOwnerUser(std::string setEventOwnerUser) {
-    eventOwnerUser = setEventOwnerUser;
+    eventOwnerUser = StringInterner::instance().intern(setEventOwnerUser);
+}
+
+void Event::set_channel_name(const std::string &channel_name) {
+    this->channel_name = StringInterner::instance().intern(channel_name);
 }
 
 const std::string &Event::getEventOwnerUser() const {
-    return eventOwnerUser;
+    return *eventOwnerUser;
 }
 
 const std::string &Event::get_channel_name() const
 {
-    return this->channel_name;
+    return *this->channel_name;
 }
 
 const std::string &Event::get_city() const
 {
-    return this->city;
+    return *this->city;
 }
 
 const std::string &Event::get_name() const
 {
-    return this->name;
+    return *this->name;
 }
 
 int Event::get_date_time() const
@@ -50,20 +78,83 @@ int Event::get_date_time() const
     return this->date_time;
 }
 
-const std::map<std::string, std::string> &Event::get_general_information() const
+const std::string &Event::get_description() const
 {
-    return this->general_information;
+    return this->description;
 }
 
-const std::string &Event::get_description() const
+Symbol Event::channel_symbol() const
 {
-    return this->description;
+    return this->channel_name;
+}
+
+Symbol Event::city_symbol() const
+{
+    return this->city;
+}
+
+Symbol Event::name_symbol() const
+{
+    return this->name;
 }
 
+unsigned char Event::get_general_flags() const
+{
+    return this->general_flags;
+}
 
-Event::Event(const std::string &frame_body): channel_name(""), city(""), 
-                                             name(""), date_time(0), description(""), general_information(),
-                                             eventOwnerUser("")
+bool Event::is_active() const
+{
+    return (general_flags & ACTIVE_TRUE) != 0;
+}
+
+bool Event::is_forces_arrival_at_scene() const
+{
+    return (general_flags & FORCES_ARRIVAL_TRUE) != 0;
+}
+
+void Event::for_each_general_information(const std::function<void(const std::string &, const std::string &)> &visit) const
+{
+    static const std::string active_key("active");
+    static const std::string forces_key("forces_arrival_at_scene");
+    static const std::string true_value("true");
+    static const std::string false_value("false");
+
+    // merge the two flags into the sorted extra entries
+    bool active_pending = (general_flags & ACTIVE_PRESENT) != 0;
+    bool forces_pending = (general_flags & FORCES_ARRIVAL_PRESENT) != 0;
+    for (const auto &entry : extra_information)
+    {
+        if (active_pending && active_key < entry.first)
+        {
+            visit(active_key, is_active() ? true_value : false_value);
+            active_pending = false;
+        }
+        if (forces_pending && forces_key < entry.first)
+        {
+            visit(forces_key, is_forces_arrival_at_scene() ? true_value : false_value);
+            forces_pending = false;
+        }
+        visit(entry.first, entry.second);
+    }
+    if (active_pending)
+        visit(active_key, is_active() ? true_value : false_value);
+    if (forces_pending)
+        visit(forces_key, is_forces_arrival_at_scene() ? true_value : false_value);
+}
+
+std::map<std::string, std::string> Event::get_general_information() const
+{
+    std::map<std::string, std::string> general_information;
+    for_each_general_information([&general_information](const std::string &key, const std::string &value)
+                                 { general_information[key] = value; });
+    return general_information;
+}
+
+
+Event::Event(const std::string &frame_body): channel_name(StringInterner::empty()), city(StringInterner::empty()),
+                                             name(StringInterner::empty()), date_time(0), description(""),
+                                             general_flags(0), extra_information(), eventOwnerUser(StringInterner::empty())
 {
     stringstream ss(frame_body);
     string line;
@@ -80,16 +171,16 @@ Event::Event(const std::string &frame_body): channel_name(""), city(""),
                 val = lineArgs.at(1);
             }
             if(key == "user") {
-                eventOwnerUser = val;
+                eventOwnerUser = StringInterner::instance().intern(val);
             }
             if(key == "channel name") {
-                channel_name = val;
+                channel_name = StringInterner::instance().intern(val);
             }
             if(key == "city") {
-                city = val;
+                city = StringInterner::instance().intern(val);
             }
             else if(key == "event name") {
-                name = val;
+                name = StringInterner::instance().intern(val);
             }
             else if(key == "date time") {
                 date_time = std::stoi(val);
@@ -110,36 +201,500 @@ Event::Event(const std::string &frame_body): channel_name(""), city(""),
             }
         }
     }
-    general_information = general_information_from_string;
+    set_general_information(general_information_from_string);
 }
 
-names_and_events parseEventsFile(std::string json_path)
+double parse_stats::megabytes_per_second() const
 {
-    std::ifstream f(json_path);
-    json data = json::parse(f);
+    return seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0;
+}
 
-    std::string channel_name = data["channel_name"];
+double parse_stats::events_per_second() const
+{
+    return seconds > 0 ? events / seconds : 0;
+}
 
-    // run over all the events and convert them to Event objects
-    std::vector<Event> events;
-    for (auto &event : data["events"])
+// SAX handler that builds Event objects as the tokens of an events file arrive.
+// Only the event being read is held, never a DOM of the whole file.
+class EventsSaxHandler : public json::json_sax_t
+{
+private:
+    enum State
+    {
+        DOCUMENT,     // before the root object
+        ROOT,         // inside the root object
+        EVENTS,       // inside the "events" array, or object whose values are the events
+        EVENT,        // inside one event object
+        GENERAL_INFO, // inside an event's "general_information" object or array
+        DONE
+    };
+
+    const std::function<void(Event &)> &on_event;
+    State state;
+    int skip_depth;           // nesting of a container whose content is ignored
+    std::string current_key; // last key read in the current object
+    bool channel_known;
+    std::vector<Event> pending; // events read before the channel name
+
+    // fields of the event being read, with the JSON type each was given, null while missing
+    std::string name;
+    std::string city;
+    int date_time;
+    std::string description;
+    std::map<std::string, std::string> general_information;
+    json::value_t name_type;
+    json::value_t city_type;
+    json::value_t date_time_type;
+    json::value_t description_type;
+    int general_index; // next index of a "general_information" array, -1 for an object
+
+    // compact JSON text of a general information value that is itself a container
+    std::string nested;
+    std::vector<bool> nested_first; // per open container, whether no element was written yet
+    bool nested_after_key;
+
+public:
+    std::string channel_name;
+    size_t events;
+    std::exception_ptr error; // the syntax error that stopped the parse, if any
+
+    EventsSaxHandler(const std::function<void(Event &)> &on_event)
+        : on_event(on_event), state(DOCUMENT), skip_depth(0), current_key(), channel_known(false), pending(),
+          name(), city(), date_time(0), description(), general_information(), name_type(json::value_t::null),
+          city_type(json::value_t::null), date_time_type(json::value_t::null),
+          description_type(json::value_t::null), general_index(-1), nested(), nested_first(),
+          nested_after_key(false), channel_name(), events(0), error()
+    {
+    }
+
+    // hand over events that were waiting for the channel name.
+    // a file without one fails the way converting the missing name to a string did.
+    void finish()
+    {
+        if (!channel_known)
+            json().get<std::string>();
+        flush_pending();
+    }
+
+    bool null() override { return scalar(json(nullptr)); }
+    bool boolean(bool val) override { return scalar(json(val)); }
+    bool number_integer(number_integer_t val) override { return scalar(json(val)); }
+    bool number_unsigned(number_unsigned_t val) override { return scalar(json(val)); }
+    bool number_float(number_float_t val, const string_t &) override { return scalar(json(val)); }
+    bool binary(binary_t &) override { return scalar(json()); }
+
+    bool string(string_t &val) override
     {
-        std::string name = event["event_name"];
-        std::string city = event["city"];
-        int date_time = event["date_time"];
-        std::string description = event["description"];
-        std::map<std::string, std::string> general_information;
-        for (auto &update : event["general_information"].items())
+        if (skip_depth > 0)
+            return true;
+        next_general_index();
+        if (!nested_first.empty())
         {
-            if (update.value().is_string())
-                general_information[update.key()] = update.value();
+            nested_separator();
+            nested += json(val).dump();
+            return true;
+        }
+        if (state == ROOT && current_key == "channel_name")
+        {
+            channel_name = val;
+            channel_known = true;
+            flush_pending();
+        }
+        else if (state == EVENT)
+        {
+            if (current_key == "event_name")
+                name = std::move(val);
+            else if (current_key == "city")
+                city = std::move(val);
+            else if (current_key == "description")
+                description = std::move(val);
+            else if (current_key == "general_information")
+                general_information[""] = std::move(val); // as iterating the items of a string did
+            field_type(json::value_t::string);
+        }
+        else if (state == GENERAL_INFO)
+        {
+            general_information[current_key] = std::move(val);
+        }
+        else
+        {
+            return scalar(json(std::move(val)));
+        }
+        return true;
+    }
+
+    bool key(string_t &val) override
+    {
+        if (skip_depth > 0)
+            return true;
+        if (!nested_first.empty())
+        {
+            nested_separator();
+            nested += json(val).dump();
+            nested += ':';
+            nested_after_key = true;
+            return true;
+        }
+        current_key = std::move(val);
+        return true;
+    }
+
+    bool start_object(std::size_t) override
+    {
+        if (skip_depth > 0)
+            return start_ignored('{');
+        next_general_index();
+        if (!nested_first.empty())
+            return start_ignored('{');
+        switch (state)
+        {
+        case DOCUMENT:
+            state = ROOT;
+            return true;
+        case ROOT:
+            if (current_key == "events")
+            {
+                state = EVENTS;
+                return true;
+            }
+            return start_ignored('{');
+        case EVENTS:
+            name.clear();
+            city.clear();
+            date_time = 0;
+            description.clear();
+            general_information.clear();
+            name_type = city_type = date_time_type = description_type = json::value_t::null;
+            state = EVENT;
+            return true;
+        case EVENT:
+            if (current_key == "general_information")
+            {
+                general_index = -1;
+                state = GENERAL_INFO;
+                return true;
+            }
+            field_type(json::value_t::object);
+            return start_ignored('{');
+        default:
+            return start_ignored('{');
+        }
+    }
+
+    bool end_object() override
+    {
+        if (skip_depth > 0 || !nested_first.empty())
+            return end_ignored('}');
+        switch (state)
+        {
+        case ROOT:
+            state = DONE;
+            break;
+        case EVENTS:
+            state = ROOT;
+            break;
+        case EVENT:
+        {
+            check_fields();
+            // the fields are reset when the next event starts, so hand them over
+            Event event(channel_name, std::move(city), std::move(name), date_time, std::move(description),
+                        std::move(general_information));
+            if (channel_known)
+                emit(event);
+            else
+                pending.push_back(std::move(event));
+            state = EVENTS;
+            break;
+        }
+        case GENERAL_INFO:
+            state = EVENT;
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        if (skip_depth > 0)
+            return start_ignored('[');
+        next_general_index();
+        if (!nested_first.empty())
+            return start_ignored('[');
+        switch (state)
+        {
+        case DOCUMENT:
+            json(json::value_t::array)["channel_name"]; // same type error as indexing an array root
+            return true;
+        case ROOT:
+            if (current_key == "events")
+            {
+                state = EVENTS;
+                return true;
+            }
+            return start_ignored('[');
+        case EVENTS:
+            json(json::value_t::array)["event_name"]; // same type error as indexing an array event
+            return true;
+        case EVENT:
+            if (current_key == "general_information")
+            {
+                general_index = 0; // items() of an array are keyed by index
+                state = GENERAL_INFO;
+                return true;
+            }
+            field_type(json::value_t::array);
+            return start_ignored('[');
+        default:
+            return start_ignored('[');
+        }
+    }
+
+    bool end_array() override
+    {
+        if (skip_depth > 0 || !nested_first.empty())
+            return end_ignored(']');
+        if (state == EVENTS)
+            state = ROOT;
+        else if (state == GENERAL_INFO)
+            state = EVENT;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &ex) override
+    {
+        // ex is only the base class, so keep a copy of what was really thrown and stop;
+        // the caller rethrows it after sax_parse returns, as json::parse would have thrown it
+        if (const json::parse_error *parse = dynamic_cast<const json::parse_error *>(&ex))
+            error = std::make_exception_ptr(*parse);
+        else if (const json::out_of_range *range = dynamic_cast<const json::out_of_range *>(&ex))
+            error = std::make_exception_ptr(*range);
+        else if (const json::type_error *type = dynamic_cast<const json::type_error *>(&ex))
+            error = std::make_exception_ptr(*type);
+        else if (const json::invalid_iterator *iterator = dynamic_cast<const json::invalid_iterator *>(&ex))
+            error = std::make_exception_ptr(*iterator);
+        else if (const json::other_error *other = dynamic_cast<const json::other_error *>(&ex))
+            error = std::make_exception_ptr(*other);
+        else
+            error = std::make_exception_ptr(std::runtime_error(ex.what()));
+        return false;
+    }
+
+private:
+    void emit(Event &event)
+    {
+        if (event.get_channel_name() != channel_name)
+            event.set_channel_name(channel_name);
+        ++events;
+        on_event(event);
+    }
+
+    void flush_pending()
+    {
+        for (Event &event : pending)
+            emit(event);
+        pending.clear();
+    }
+
+    bool scalar(const json &val)
+    {
+        if (skip_depth > 0)
+            return true;
+        next_general_index();
+        if (!nested_first.empty())
+        {
+            nested_separator();
+            append_text(nested, val);
+            return true;
+        }
+        switch (state)
+        {
+        case DOCUMENT:
+        {
+            // indexing a scalar root fails, a null one reads as an object without a channel name
+            json root = val;
+            root["channel_name"].get<std::string>();
+            state = DONE;
+            break;
+        }
+        case ROOT:
+            if (current_key == "channel_name")
+            {
+                val.get<std::string>(); // same type error the DOM conversion raised
+            }
+            else if (current_key == "events" && !val.is_null())
+            {
+                json event = val; // iterating a scalar visits the scalar itself, which cannot be indexed
+                event["event_name"];
+            }
+            break;
+        case EVENTS:
+        {
+            // a null event reads as an object without fields, anything else cannot be indexed
+            json event = val;
+            event["event_name"].get<std::string>();
+            break;
+        }
+        case EVENT:
+            if (current_key == "date_time" && val.is_primitive() && !val.is_null() && !val.is_string())
+                date_time = val.get<int>();
+            else if (current_key == "general_information" && !val.is_null())
+            {
+                // as iterating the items of a scalar did
+                std::string &text = general_information[""];
+                text.clear();
+                append_text(text, val);
+            }
+            field_type(val.type());
+            break;
+        case GENERAL_INFO:
+        {
+            std::string &text = general_information[current_key];
+            text.clear();
+            append_text(text, val);
+            break;
+        }
+        default:
+            break;
+        }
+        return true;
+    }
+
+    // remember the JSON type given to one of the event's fields
+    void field_type(json::value_t type)
+    {
+        if (current_key == "event_name")
+            name_type = type;
+        else if (current_key == "city")
+            city_type = type;
+        else if (current_key == "date_time")
+            date_time_type = type;
+        else if (current_key == "description")
+            description_type = type;
+    }
+
+    // raise the type error the DOM conversion of the first bad field raised, in the order it
+    // converted them: a missing field converted from null, a mistyped one from its type
+    void check_fields() const
+    {
+        if (name_type != json::value_t::string)
+            json(name_type).get<std::string>();
+        if (city_type != json::value_t::string)
+            json(city_type).get<std::string>();
+        if (date_time_type != json::value_t::number_integer && date_time_type != json::value_t::number_unsigned &&
+            date_time_type != json::value_t::number_float && date_time_type != json::value_t::boolean)
+            json(date_time_type).get<int>();
+        if (description_type != json::value_t::string)
+            json(description_type).get<std::string>();
+    }
+
+    // elements of a "general_information" array are keyed by their index
+    void next_general_index()
+    {
+        if (state == GENERAL_INFO && general_index >= 0 && nested_first.empty())
+            current_key = std::to_string(general_index++);
+    }
+
+    // JSON text of a scalar. json::dump() allocates a 512 byte indent buffer on every call,
+    // so the common values are written directly.
+    static void append_text(std::string &out, const json &val)
+    {
+        switch (val.type())
+        {
+        case json::value_t::null:
+            out += "null";
+            break;
+        case json::value_t::boolean:
+            out += val.get<bool>() ? "true" : "false";
+            break;
+        case json::value_t::number_integer:
+            out += std::to_string(val.get<json::number_integer_t>());
+            break;
+        case json::value_t::number_unsigned:
+            out += std::to_string(val.get<json::number_unsigned_t>());
+            break;
+        default:
+            out += val.dump();
+            break;
+        }
+    }
+
+    // a container we do not map onto an Event field: general information values are kept as
+    // their JSON text, anything else is skipped
+    bool start_ignored(char open)
+    {
+        if (skip_depth == 0 && (state == GENERAL_INFO || !nested_first.empty()))
+        {
+            if (nested_first.empty())
+                nested.clear();
             else
-                general_information[update.key()] = update.value().dump();
+                nested_separator();
+            nested += open;
+            nested_first.push_back(true);
+            return true;
         }
+        ++skip_depth;
+        return true;
+    }
+
+    bool end_ignored(char close)
+    {
+        if (skip_depth > 0)
+        {
+            --skip_depth;
+            return true;
+        }
+        nested += close;
+        nested_first.pop_back();
+        if (nested_first.empty())
+            general_information[current_key] = nested;
+        return true;
+    }
+
+    void nested_separator()
+    {
+        if (nested_after_key)
+        {
+            nested_after_key = false;
+            return;
+        }
+        if (!nested_first.back())
+            nested += ',';
+        nested_first.back() = false;
+    }
+};
+
+std::string parseEventsFileStreaming(const std::string &json_path, const std::function<void(Event &)> &on_event,
+                                     parse_stats *stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // parse straight out of the mapped pages, an unreadable file parses as empty input and throws
+    MappedFile file;
+    file.open(json_path);
+
+    EventsSaxHandler handler(on_event);
+    if (!json::sax_parse(file.data(), file.data() + file.size(), &handler) && handler.error)
+        std::rethrow_exception(handler.error);
+    handler.finish();
 
-        events.push_back(Event(channel_name, city, name, date_time, description, general_information));
+    if (stats)
+    {
+        stats->bytes = file.size();
+        stats->events = handler.events;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     }
-    names_and_events events_and_names{channel_name, events};
+    return handler.channel_name;
+}
+
+names_and_events parseEventsFile(std::string json_path, parse_stats *stats)
+{
+    // run over all the events as they are read, keeping the Event objects
+    std::vector<Event> events;
+    std::string channel_name = parseEventsFileStreaming(json_path, [&events](Event &event)
+                                                        { events.push_back(std::move(event)); }, stats);
+    names_and_events events_and_names{std::move(channel_name), std::move(events)};
 
     return events_and_names;
 }